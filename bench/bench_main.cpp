@@ -0,0 +1,343 @@
+// GribBench: micro- and macro-benchmarks of the core library on synthetic
+// GRIB data. Results go to a JSON file for comparison between releases.
+//
+//   GribBench [-o results.json] [--dir DIR] [--reps N] [--quick] [--only NAME]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "color_adjust.h"
+#include "export_image.h"
+#include "field_render.h"
+#include "grib_collection.h"
+#include "grib_reader.h"
+#include "settings.h"
+#include "synthetic_grib.h"
+#include "task_scheduler.h"
+#include "value_mask.h"
+#include "value_pool.h"
+
+#ifndef GRIBVIEWER_VERSION
+#define GRIBVIEWER_VERSION "unknown"
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchOptions {
+    std::string output;
+    std::string dataDir = ".";
+    std::string only;
+    int reps = 5;
+    bool quick = false;
+};
+
+struct BenchResult {
+    std::string name;
+    std::string dataset;
+    int reps = 0;
+    double minSeconds = 0.;
+    double medianSeconds = 0.;
+    // work per repetition; throughput is computed from the best time
+    double messages = 0.;
+    double bytes = 0.;
+    double pixels = 0.;
+};
+
+std::vector<BenchResult> results;
+
+// Runs fn once to warm up, then opt.reps timed repetitions. `setup`, if
+// given, runs untimed before each call.
+void bench(const BenchOptions& opt, const std::string& name, const std::string& dataset,
+    double messages, double bytes, double pixels, const std::function<void()>& fn,
+    const std::function<void()>& setup = {}) {
+    if (!opt.only.empty() && opt.only != name) return;
+
+    if (setup) setup();
+    fn();
+    std::vector<double> times;
+    for (int r = 0; r < opt.reps; ++r) {
+        if (setup) setup();
+        Clock::time_point t0 = Clock::now();
+        fn();
+        times.push_back(std::chrono::duration<double>(Clock::now() - t0).count());
+    }
+    std::sort(times.begin(), times.end());
+
+    BenchResult res;
+    res.name = name;
+    res.dataset = dataset;
+    res.reps = opt.reps;
+    res.minSeconds = times.front();
+    res.medianSeconds = times[times.size() / 2];
+    res.messages = messages;
+    res.bytes = bytes;
+    res.pixels = pixels;
+    results.push_back(res);
+
+    std::fprintf(stderr, "  %-14s %-32s %10.3f ms\n", name.c_str(), dataset.c_str(),
+        res.minSeconds * 1e3);
+}
+
+// Keeps the optimiser from discarding benchmark results.
+volatile double sink = 0.;
+
+void writeJson(FILE* f, const BenchOptions& opt) {
+    std::time_t now = std::time(nullptr);
+    char date[32];
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+    std::fprintf(f, "{\n");
+    std::fprintf(f, "  \"version\": \"%s\",\n", GRIBVIEWER_VERSION);
+    std::fprintf(f, "  \"date\": \"%s\",\n", date);
+    std::fprintf(f, "  \"threads\": %u,\n", TaskScheduler::instance().concurrency());
+    std::fprintf(f, "  \"reps\": %d,\n", opt.reps);
+    std::fprintf(f, "  \"quick\": %s,\n", opt.quick ? "true" : "false");
+    std::fprintf(f, "  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        double t = r.minSeconds > 0. ? r.minSeconds : 1e-12;
+        std::fprintf(f, "    {\"name\": \"%s\", \"dataset\": \"%s\", \"reps\": %d, "
+            "\"min_s\": %.6g, \"median_s\": %.6g",
+            r.name.c_str(), r.dataset.c_str(), r.reps, r.minSeconds, r.medianSeconds);
+        if (r.messages > 0.) std::fprintf(f, ", \"messages_per_s\": %.6g", r.messages / t);
+        if (r.bytes > 0.) std::fprintf(f, ", \"gb_per_s\": %.6g", r.bytes / t / 1e9);
+        if (r.pixels > 0.) std::fprintf(f, ", \"mpixel_per_s\": %.6g", r.pixels / t / 1e6);
+        std::fprintf(f, "}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(f, "  ]\n}\n");
+}
+
+bool parseArgs(int argc, char** argv, BenchOptions& opt) {
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (a == "-o" && hasValue) opt.output = argv[++i];
+        else if (a == "--dir" && hasValue) opt.dataDir = argv[++i];
+        else if (a == "--only" && hasValue) opt.only = argv[++i];
+        else if (a == "--reps" && hasValue) opt.reps = std::max(1, std::atoi(argv[++i]));
+        else if (a == "--quick") opt.quick = true;
+        else return false;
+    }
+    return true;
+}
+
+// Reader-level benchmarks on one synthetic file.
+void benchFile(const BenchOptions& opt, const SyntheticSpec& spec, const std::string& path,
+    size_t fileBytes) {
+    const std::string dataset = spec.name();
+    const double n = spec.messages;
+
+    bench(opt, "scan", dataset, n, fileBytes, 0., [&]() {
+        GribReader reader;
+        char buf[512];
+        std::snprintf(buf, sizeof(buf), "%s", path.c_str());
+        reader.loadFile(buf);
+        sink = sink + reader.messageCount;
+    });
+
+    GribReader reader;
+    char buf[512];
+    std::snprintf(buf, sizeof(buf), "%s", path.c_str());
+    reader.loadFile(buf);
+    if (reader.messageCount == 0) return;
+
+    bench(opt, "metadata", dataset, n, 0., 0., [&]() {
+        GribMessageInfo info;
+        for (int i = 0; i < reader.messageCount; ++i) {
+            reader.readFieldMetadata(i, info);
+            sink = sink + info.level;
+        }
+    });
+
+    // Decode from memory, so this measures unpacking rather than I/O.
+    std::vector<std::vector<unsigned char>> messages(reader.messageCount);
+    for (int i = 0; i < reader.messageCount; ++i)
+        reader.readMessage(i, messages[i]);
+    double values = static_cast<double>(spec.ni) * spec.nj * n;
+    bench(opt, "decode", dataset, n, fileBytes, values, [&]() {
+        GribField field;
+        for (const auto& bytes : messages) {
+            reader.readFieldFromMessage(bytes, field, false);
+            sink = sink + field.values[0];
+        }
+    });
+
+    bench(opt, "read_field", dataset, n, fileBytes, values, [&]() {
+        GribField field;
+        for (int i = 0; i < reader.messageCount; ++i) {
+            reader.readField(i, field);
+            sink = sink + field.values[0];
+        }
+    });
+}
+
+// Colour path and export benchmarks on one decoded field.
+void benchRender(const BenchOptions& opt, const SyntheticSpec& spec, const std::string& path) {
+    GribReader reader;
+    char buf[512];
+    std::snprintf(buf, sizeof(buf), "%s", path.c_str());
+    reader.loadFile(buf);
+    GribField field;
+    if (reader.messageCount == 0 || !reader.readField(0, field)) return;
+
+    char size[64];
+    std::snprintf(size, sizeof(size), "%ldx%ld", field.width, field.height);
+    const std::string dataset = size;
+    const double pixels = static_cast<double>(field.width) * field.height;
+    const double valueBytes = pixels * sizeof(double);
+
+    // scanValues as decodeField runs it: without missing values, and with a
+    // third of the field set to the missing sentinel, which it turns into NaN
+    // and a mask, so each repetition starts from a fresh copy
+    FieldValues scanned;
+    std::vector<uint64_t> mask;
+    bench(opt, "minmax", dataset, 0., valueBytes, pixels, [&]() {
+        double lo = 0., hi = 0.;
+        scanValues(scanned.data(), scanned.size(), nullptr, mask, lo, hi);
+        sink = sink + lo + hi;
+    }, [&]() { scanned = field.values; });
+
+    const double missing = 1.0e36;
+    FieldValues withGaps = field.values;
+    for (long y = 0; y < field.height; ++y)
+        for (long x = 0; x < field.width / 3; ++x)
+            withGaps[static_cast<size_t>(y) * field.width + (x + y) % field.width] = missing;
+    bench(opt, "minmax_masked", dataset, 0., valueBytes, pixels, [&]() {
+        double lo = 0., hi = 0.;
+        sink = sink + scanValues(scanned.data(), scanned.size(), &missing, mask, lo, hi);
+        sink = sink + lo + hi;
+    }, [&]() { scanned = withGaps; });
+
+    GribViewerSettings settings;
+    const Gradient& gradient = GradientRegistry::instance().gradient(settings.gradient);
+    std::vector<Color> img(field.values.size());
+    bench(opt, "value_to_color", dataset, 0., 0., pixels, [&]() {
+        const double lo = field.min_value;
+        const double hi = field.max_value;
+        for (size_t i = 0; i < field.values.size(); ++i)
+            img[i] = valueToColor(field.values[i], lo, hi, gradient, settings);
+        sink = sink + img[0].r;
+    });
+
+    bench(opt, "render_field", dataset, 0., 0., pixels, [&]() {
+        colorizeField(field, field.width, field.height, settings, img);
+        sink = sink + img[0].r;
+    });
+
+    bench(opt, "hcl_adjust", dataset, 0., 0., pixels, [&]() {
+        float acc = 0.f;
+        for (const Color& c : img)
+            acc += applyHclAdjustments(c, 1.1f, 0.9f, 1.2f, 15.f).g;
+        sink = sink + acc;
+    });
+
+    const std::string png = opt.dataDir + "/bench_" + dataset + ".png";
+    bench(opt, "png_export", dataset, 0., 0., pixels, [&]() {
+        exportImagePng(png, field.width, field.height, img, field.jScansPositively);
+    });
+    std::remove(png.c_str());
+}
+
+// Multi-column sort of a large message list, as done by the sort window.
+void benchSort(const BenchOptions& opt, const std::vector<GribMessageInfo>& seed) {
+    if (seed.empty()) return;
+    const size_t count = opt.quick ? 20000 : 200000;
+    std::vector<GribMessageInfo> list;
+    list.reserve(count);
+    uint64_t s = 88172645463325252ull;
+    for (size_t i = 0; i < count; ++i) {
+        GribMessageInfo m = seed[i % seed.size()];
+        s ^= s << 13; s ^= s >> 7; s ^= s << 17;
+        m.level = static_cast<long>(s % 1000);
+        m.step = static_cast<long>((s >> 20) % 240);
+        m.indexInFile = static_cast<int>(i);
+        list.push_back(std::move(m));
+    }
+    const std::vector<SortColumn> order = {
+        {SortKey::ShortName, true}, {SortKey::Level, false}, {SortKey::Step, true} };
+    bench(opt, "sort", std::to_string(count) + "_messages", static_cast<double>(count), 0., 0.,
+        [&]() {
+            std::vector<GribMessageInfo> copy = list;
+            sortWithOrder(copy, order);
+            sink = sink + copy[0].level;
+        });
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BenchOptions opt;
+    if (!parseArgs(argc, argv, opt)) {
+        std::fprintf(stderr,
+            "Usage: %s [-o results.json] [--dir DIR] [--reps N] [--quick] [--only NAME]\n",
+            argv[0]);
+        return 2;
+    }
+    if (opt.quick) opt.reps = std::min(opt.reps, 2);
+
+    struct Size { long ni, nj; int messages; };
+    std::vector<Size> sizes = { {360, 181, 48}, {1440, 721, 12}, {2880, 1441, 4} };
+    if (opt.quick) sizes = { {360, 181, 12}, {1440, 721, 4} };
+
+    struct Packing { int edition; const char* type; long bits; };
+    const Packing packings[] = {
+        {1, "grid_simple", 16},
+        {2, "grid_simple", 16},
+        {2, "grid_simple", 24},
+        {2, "grid_ccsds", 16},
+    };
+
+    std::vector<GribMessageInfo> sortSeed;
+    for (const Size& sz : sizes) {
+        bool renderedSize = false;
+        for (const Packing& p : packings) {
+            SyntheticSpec spec;
+            spec.edition = p.edition;
+            spec.packingType = p.type;
+            spec.bitsPerValue = p.bits;
+            spec.ni = sz.ni;
+            spec.nj = sz.nj;
+            spec.messages = sz.messages;
+
+            const std::string path = opt.dataDir + "/" + spec.name() + ".grib";
+            size_t bytes = 0;
+            if (!writeSyntheticGrib(path, spec, 42, bytes)) {
+                std::fprintf(stderr, "  skipping %s (not supported by this eccodes)\n",
+                    spec.name().c_str());
+                std::remove(path.c_str());
+                continue;
+            }
+
+            benchFile(opt, spec, path, bytes);
+            if (!renderedSize) {
+                benchRender(opt, spec, path);
+                renderedSize = true;
+            }
+            if (sortSeed.empty()) {
+                GribCollection collection;
+                collection.beginLoad({path});
+                while (collection.loadNext()) {}
+                sortSeed = collection.messageList;
+            }
+            std::remove(path.c_str());
+        }
+    }
+    benchSort(opt, sortSeed);
+
+    FILE* f = opt.output.empty() ? stdout : fopen(opt.output.c_str(), "w");
+    if (!f) {
+        std::fprintf(stderr, "Cannot write %s\n", opt.output.c_str());
+        return 1;
+    }
+    writeJson(f, opt);
+    if (f != stdout) fclose(f);
+    return 0;
+}
@@ -0,0 +1,101 @@
+#include "synthetic_grib.h"
+
+#include <eccodes.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+uint64_t xorshift(uint64_t& s) {
+    s ^= s << 13;
+    s ^= s >> 7;
+    s ^= s << 17;
+    return s;
+}
+
+// Smooth large-scale pattern plus a little noise, so packing sees realistic
+// value ranges instead of constants.
+void fillValues(std::vector<double>& values, long ni, long nj, int k, uint64_t seed) {
+    uint64_t s = seed * 0x9e3779b97f4a7c15ull + static_cast<uint64_t>(k) + 1;
+    for (long j = 0; j < nj; ++j) {
+        double lat = M_PI * (0.5 - static_cast<double>(j) / (nj - 1));
+        for (long i = 0; i < ni; ++i) {
+            double lon = 2. * M_PI * i / ni;
+            double noise = static_cast<double>(xorshift(s) >> 11) / 9007199254740992.0 - 0.5;
+            values[j * ni + i] = 250. + 35. * std::cos(lat)
+                + 6. * std::sin(3. * lon + 0.3 * k) * std::cos(2. * lat)
+                + 0.5 * noise;
+        }
+    }
+}
+
+bool setString(codes_handle* h, const char* key, const char* value) {
+    size_t len = std::strlen(value);
+    return codes_set_string(h, key, value, &len) == 0;
+}
+
+} // namespace
+
+std::string SyntheticSpec::name() const {
+    char buf[128];
+    std::snprintf(buf, sizeof(buf), "grib%d_%s_%ld_%ldx%ld", edition, packingType,
+        bitsPerValue, ni, nj);
+    return buf;
+}
+
+bool writeSyntheticGrib(const std::string& path, const SyntheticSpec& spec, uint64_t seed,
+    size_t& bytesWritten) {
+    bytesWritten = 0;
+    const char* sample = spec.edition == 1 ? "regular_ll_sfc_grib1" : "regular_ll_sfc_grib2";
+    codes_handle* h = codes_grib_handle_new_from_samples(nullptr, sample);
+    if (!h) return false;
+
+    double dx = 360. / spec.ni;
+    double dy = 180. / (spec.nj - 1);
+    bool ok = codes_set_long(h, "Ni", spec.ni) == 0 &&
+        codes_set_long(h, "Nj", spec.nj) == 0 &&
+        codes_set_long(h, "jScansPositively", 0) == 0 &&
+        codes_set_double(h, "latitudeOfFirstGridPointInDegrees", 90.) == 0 &&
+        codes_set_double(h, "longitudeOfFirstGridPointInDegrees", 0.) == 0 &&
+        codes_set_double(h, "latitudeOfLastGridPointInDegrees", -90.) == 0 &&
+        codes_set_double(h, "longitudeOfLastGridPointInDegrees", 360. - dx) == 0 &&
+        codes_set_double(h, "iDirectionIncrementInDegrees", dx) == 0 &&
+        codes_set_double(h, "jDirectionIncrementInDegrees", dy) == 0 &&
+        setString(h, "typeOfLevel", "isobaricInhPa") &&
+        codes_set_long(h, "bitsPerValue", spec.bitsPerValue) == 0 &&
+        setString(h, "packingType", spec.packingType);
+    if (!ok) {
+        codes_handle_delete(h);
+        return false;
+    }
+
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) {
+        codes_handle_delete(h);
+        return false;
+    }
+
+    static const char* const params[] = { "t", "u", "v", "r" };
+    static const long levels[] = { 850, 500, 250 };
+    std::vector<double> values(static_cast<size_t>(spec.ni) * spec.nj);
+    for (int k = 0; k < spec.messages && ok; ++k) {
+        fillValues(values, spec.ni, spec.nj, k, seed);
+        ok = setString(h, "shortName", params[k % 4]) &&
+            codes_set_long(h, "level", levels[(k / 4) % 3]) == 0 &&
+            codes_set_long(h, "step", 6 * (k / 12)) == 0 &&
+            codes_set_double_array(h, "values", values.data(), values.size()) == 0;
+
+        const void* msg = nullptr;
+        size_t size = 0;
+        ok = ok && codes_get_message(h, &msg, &size) == 0 &&
+            fwrite(msg, 1, size, f) == size;
+        bytesWritten += size;
+    }
+
+    fclose(f);
+    codes_handle_delete(h);
+    return ok;
+}
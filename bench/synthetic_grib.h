@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Deterministic synthetic GRIB files built from the eccodes samples, so the
+// benchmarks do not depend on downloaded data.
+struct SyntheticSpec {
+    int edition = 2;                          // 1 or 2
+    long ni = 360;
+    long nj = 181;
+    const char* packingType = "grid_simple";  // grid_simple, grid_ccsds, ...
+    long bitsPerValue = 16;
+    int messages = 8;
+
+    std::string name() const;
+};
+
+// Writes spec.messages global regular_ll fields (alternating parameters,
+// increasing steps) to path. Same spec and seed give the same bytes.
+// Returns false if the sample or packing is not available in this eccodes.
+bool writeSyntheticGrib(const std::string& path, const SyntheticSpec& spec, uint64_t seed,
+    size_t& bytesWritten);
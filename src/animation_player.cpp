@@ -0,0 +1,269 @@
+#include "animation_player.h"
+
+#include <algorithm>
+#include <imgui.h>
+
+#include "field_render.h"
+#include "frame_scheduler.h"
+#include "renderer.h"
+#include "trace.h"
+
+// Creating the scheduler first makes it outlive a static player, whose
+// destructor still waits for queued frames.
+AnimationPlayer::AnimationPlayer() {
+    TaskScheduler::instance();
+}
+
+// The texture is not released here, for the same reason as in LutRenderer.
+AnimationPlayer::~AnimationPlayer() {
+    ++generation;
+    jobs.wait();
+}
+
+void AnimationPlayer::start(const GribCollection& c, std::vector<size_t> s, size_t startGlobal,
+                            const GribViewerSettings& st) {
+    stop();
+    if (s.size() < 2) return;
+
+    auto it = std::find(s.begin(), s.end(), startGlobal);
+    startPos = it == s.end() ? 0 : static_cast<int>(it - s.begin());
+    shownPos = startPos;
+    collection = &c;
+    series = std::move(s);
+    settings = st;
+    if (maxTextureSize == 0)
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+
+    stat = AnimationStats();
+    decodeTotal = renderTotal = uploadTotal = 0.;
+    missedTicks = 0;
+    nextTicket = 0;
+    nextDue = Clock::now();
+    for (unsigned long t = 0; t < lookahead; ++t) schedule(t);
+}
+
+void AnimationPlayer::stop() {
+    if (!active()) return;
+    cancelPending();
+    collection = nullptr;
+    series.clear();
+    shown = GribField();
+    Renderer::deleteTexture(texture);
+    textureWidth = textureHeight = 0;
+}
+
+void AnimationPlayer::setSettings(const GribViewerSettings& st) {
+    if (!active()) return;
+    settings = st;
+    for (unsigned long t = nextTicket; t < nextTicket + lookahead; ++t) schedule(t);
+}
+
+void AnimationPlayer::cancelPending() {
+    ++generation;
+    jobs.wait();
+    for (Frame& f : frames) {
+        f.state.store(Empty);
+        f.decodedPosition = -1;
+    }
+}
+
+int AnimationPlayer::positionOf(unsigned long ticket) const {
+    const unsigned long n = series.size();
+    if (n == 0) return -1;
+    const unsigned long pos = startPos + ticket;
+    if (pos < n) return static_cast<int>(pos);
+    return loop ? static_cast<int>(pos % n) : -1;
+}
+
+void AnimationPlayer::schedule(unsigned long ticket) {
+    const int position = positionOf(ticket);
+    if (position < 0) return;
+    Frame& f = slot(ticket);
+    std::lock_guard<std::mutex> lock(f.mutex);
+    f.wantPosition = position;
+    f.wantSettings = settings;
+    ++f.wantVersion;
+    f.outdated = false;
+    f.state.store(Pending);
+    // a busy frame picks the new request up when its task finishes
+    if (!f.busy) {
+        f.busy = true;
+        const unsigned gen = generation.load();
+        jobs.run([this, &f, gen]() { process(f, gen); });
+    }
+}
+
+void AnimationPlayer::process(Frame& f, unsigned gen) {
+    while (generation.load() == gen) {
+        int position;
+        GribViewerSettings st;
+        unsigned long version;
+        {
+            std::lock_guard<std::mutex> lock(f.mutex);
+            position = f.wantPosition;
+            st = f.wantSettings;
+            version = f.wantVersion;
+        }
+
+        bool ok = true;
+        if (f.decodedPosition != position) {
+            TRACE_SCOPE("animationDecode", "decode");
+            Clock::time_point t0 = Clock::now();
+            ok = collection->readFieldAt(series[position], f.field, f.bytes, false);
+            f.decodeMs = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+            f.decodedPosition = ok ? position : -1;
+            if (ok) {
+                // colour as a separate task, so the next frame's decode can start meanwhile
+                jobs.run([this, &f, gen]() { process(f, gen); });
+                return;
+            }
+        }
+        if (ok) ok = colour(f, st);
+
+        std::lock_guard<std::mutex> lock(f.mutex);
+        // a frame for another position starts over; one with older settings
+        // is still published, so a stream of changes cannot starve playback
+        if (f.wantVersion != version && f.wantPosition != position) continue;
+        f.position = position;
+        f.busy = false;
+        f.outdated = f.wantVersion != version;
+        f.state.store(ok ? Ready : Failed, std::memory_order_release);
+        FrameScheduler::instance().requestFrame();
+        return;
+    }
+    std::lock_guard<std::mutex> lock(f.mutex);
+    f.busy = false;
+}
+
+bool AnimationPlayer::colour(Frame& f, const GribViewerSettings& st) {
+    TRACE_SCOPE("animationRender", "render");
+    Clock::time_point t1 = Clock::now();
+    GribField& field = f.field;
+    int shift = std::max(0, st.zoomOutLevel);
+    auto scaled = [&shift](long n) {
+        return static_cast<int>(std::max(1L, (n + (1L << shift) - 1) >> shift));
+    };
+    while (shift < 30 && (scaled(field.width) > maxTextureSize ||
+                          scaled(field.height) > maxTextureSize))
+        ++shift;
+
+    bool ok;
+    if (shift == 0) {
+        f.width = static_cast<int>(field.width);
+        f.height = static_cast<int>(field.height);
+        f.img.resize(static_cast<size_t>(f.width) * f.height);
+        ok = colorizeField(field, f.width, f.height, st, f.img) == ColorizeStatus::Ok;
+    } else {
+        // zoomed out: the pyramid level the main window would show
+        if (field.pyramid.levelCount() == 0)
+            field.pyramid.build(field.values, field.mask(), field.width, field.height);
+        const int level = std::min(shift, field.pyramid.levelCount());
+        const PyramidLevel* lvl = field.pyramid.level(level);
+        ok = lvl && colorizeLevel(field, level, st, f.img) == ColorizeStatus::Ok;
+        if (ok) {
+            f.width = static_cast<int>(lvl->width);
+            f.height = static_cast<int>(lvl->height);
+        }
+    }
+    f.jScansPositively = field.jScansPositively;
+    f.memory.set(f.img.capacity() * sizeof(Color));
+    f.renderMs = std::chrono::duration<double, std::milli>(Clock::now() - t1).count();
+    return ok;
+}
+
+bool AnimationPlayer::update(Renderer& renderer) {
+    if (!active()) return false;
+    const Clock::time_point now = Clock::now();
+    const Clock::duration interval = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(1.0 / std::clamp(fps, 0.5f, 60.f)));
+
+    // frames published with replaced settings are coloured again, unless due
+    for (unsigned long t = nextTicket + 1; t < nextTicket + lookahead; ++t) {
+        Frame& g = slot(t);
+        if (g.state.load(std::memory_order_acquire) != Ready) continue;
+        bool outdated;
+        {
+            std::lock_guard<std::mutex> lock(g.mutex);
+            outdated = g.outdated;
+        }
+        if (outdated) schedule(t);
+    }
+
+    if (now < nextDue) {
+        FrameScheduler::instance().requestFrameAt(nextDue);
+        return false;
+    }
+    if (positionOf(nextTicket) < 0) {
+        // end of a series played without looping
+        stop();
+        return false;
+    }
+
+    Frame& f = slot(nextTicket);
+    const int state = f.state.load(std::memory_order_acquire);
+    if (state != Ready && state != Failed) {
+        // every interval the frame is late is one dropped frame
+        if (stat.presented > 0) {
+            const int missed = static_cast<int>((now - nextDue) / interval) + 1;
+            stat.dropped += std::max(0, missed - missedTicks);
+            missedTicks = std::max(missedTicks, missed);
+            FrameScheduler::instance().requestFrameAt(nextDue + missedTicks * interval);
+        }
+        return false;
+    }
+
+    bool presented = false;
+    if (state == Ready) {
+        TRACE_SCOPE("animationUpload", "upload");
+        Clock::time_point t0 = Clock::now();
+        if (texture == 0 || f.width != textureWidth || f.height != textureHeight) {
+            Renderer::deleteTexture(texture);
+            texture = renderer.createTexture(f.width, f.height);
+            textureWidth = f.width;
+            textureHeight = f.height;
+        }
+        renderer.updateTexture(texture, f.width, f.height, f.img);
+        jScansPositively = f.jScansPositively;
+        // the slot decodes its next message into the field on screen before, unless
+        // that is this one again (a two-message loop), which it keeps
+        if (positionOf(nextTicket + lookahead) == f.position) {
+            shown = f.field;
+        } else {
+            std::swap(shown, f.field);
+            f.decodedPosition = -1;
+        }
+        uploadTotal += std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+        decodeTotal += f.decodeMs;
+        renderTotal += f.renderMs;
+        f.decodeMs = 0.;  // a later request for the same position may reuse the field
+        if (stat.presented == 0) playStart = now;
+        ++stat.presented;
+        presented = true;
+    } else {
+        ++stat.failed;
+    }
+    shownPos = f.position;
+    f.state.store(Empty);
+
+    stat.decodeMs = stat.presented > 0 ? decodeTotal / stat.presented : 0.;
+    stat.renderMs = stat.presented > 0 ? renderTotal / stat.presented : 0.;
+    stat.uploadMs = stat.presented > 0 ? uploadTotal / stat.presented : 0.;
+    const double playing = std::chrono::duration<double>(now - playStart).count();
+    stat.fps = playing > 0. ? (stat.presented - 1) / playing : 0.;
+
+    // a late frame restarts the clock instead of rushing the following ones
+    nextDue = (missedTicks > 0 ? now : nextDue) + interval;
+    missedTicks = 0;
+    schedule(nextTicket + lookahead);
+    ++nextTicket;
+    FrameScheduler::instance().requestFrameAt(nextDue);
+    return presented;
+}
+
+void AnimationPlayer::draw(float zoom) const {
+    if (texture == 0) return;
+    ImGui::Image((ImTextureID)(intptr_t)texture,
+                 ImVec2(textureWidth * zoom, textureHeight * zoom),
+                 jScansPositively ? ImVec2(0, 1) : ImVec2(0, 0),
+                 jScansPositively ? ImVec2(1, 0) : ImVec2(1, 1));
+}
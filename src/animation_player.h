@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <GL/gl.h>
+
+#include "grib_collection.h"
+#include "memory_tracker.h"
+#include "settings.h"
+#include "task_scheduler.h"
+
+class Renderer;
+
+struct AnimationStats {
+    int presented = 0;
+    // ticks at which the next frame was not ready, so the shown one was held
+    int dropped = 0;
+    int failed = 0;
+    double fps = 0.;
+    double decodeMs = 0.;  // averages per frame
+    double renderMs = 0.;
+    double uploadMs = 0.;
+};
+
+// Plays a series of messages (see GribCollection::seriesFor) at a target
+// frame rate. Frames go through a pipeline on the task scheduler: while frame
+// N is on screen, N+1 is being coloured and N+2 decoded, and the main thread
+// only uploads a finished image when it is due. Zoomed out, frames show the
+// same pyramid level and statistic as the main window.
+class AnimationPlayer {
+public:
+    // frames being prepared ahead of the shown one
+    static constexpr int lookahead = 2;
+
+    float fps = 4.f;
+    bool loop = true;
+    AnimationAxis axis = AnimationAxis::Step;
+
+    AnimationPlayer();
+    ~AnimationPlayer();
+
+    // `collection` must stay loaded until stop(). Playback begins at
+    // `startGlobal`; series shorter than two messages are not played.
+    void start(const GribCollection& collection, std::vector<size_t> series, size_t startGlobal,
+               const GribViewerSettings& settings);
+    void stop();
+    // Re-colours frames not yet shown with new settings, without waiting
+    // for the ones in flight; decoded fields are kept.
+    void setSettings(const GribViewerSettings& settings);
+
+    bool active() const { return collection != nullptr; }
+    // false until the first frame has been uploaded
+    bool hasFrame() const { return active() && stat.presented > 0; }
+
+    // Once per frame: presents the next frame if it is due and ready and
+    // keeps the pipeline full. Returns true when a new frame was presented.
+    bool update(Renderer& renderer);
+    void draw(float zoom) const;
+
+    // globalIndex of the message on screen
+    size_t shownGlobalIndex() const { return series.empty() ? 0 : series[shownPos]; }
+    // the field of the last frame uploaded, once hasFrame()
+    const GribField& shownField() const { return shown; }
+    int shownPosition() const { return shownPos; }
+    int length() const { return static_cast<int>(series.size()); }
+    const AnimationStats& stats() const { return stat; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    enum FrameState { Empty, Pending, Ready, Failed };
+
+    struct Frame {
+        std::atomic<int> state{Empty};
+        // what the frame should show; the main thread changes it at any time
+        std::mutex mutex;
+        bool busy = false;      // a task is bringing the frame up to date
+        bool outdated = false;  // Ready, but coloured with settings since replaced
+        unsigned long wantVersion = 0;
+        int wantPosition = -1;
+        GribViewerSettings wantSettings;
+
+        // owned by that task, and by the main thread once Ready or Failed
+        int position = -1;
+        int decodedPosition = -1;  // of `field`
+        GribField field;
+        std::vector<unsigned char> bytes;
+        std::vector<Color> img;
+        int width = 0;
+        int height = 0;
+        bool jScansPositively = false;
+        double decodeMs = 0.;
+        double renderMs = 0.;
+        MemoryCharge memory{MemCategory::ImageBuffers};
+    };
+
+    // frames are numbered in playback order; a looping series repeats positions
+    Frame& slot(unsigned long ticket) { return frames[ticket % lookahead]; }
+    int positionOf(unsigned long ticket) const;
+    void schedule(unsigned long ticket);
+    void process(Frame& f, unsigned gen);
+    bool colour(Frame& f, const GribViewerSettings& st);
+    void cancelPending();
+
+    const GribCollection* collection = nullptr;
+    std::vector<size_t> series;
+    GribViewerSettings settings;
+    int startPos = 0;
+    int shownPos = 0;
+    unsigned long nextTicket = 0;  // tickets nextTicket .. + lookahead - 1 are in the pipeline
+    int missedTicks = 0;
+    int maxTextureSize = 0;
+
+    Frame frames[lookahead];
+    TaskGroup jobs{TaskPriority::Prefetch};
+    std::atomic<unsigned> generation{0};  // bumped by stop()
+
+    GribField shown;  // taken over from the frame that was uploaded last
+    GLuint texture = 0;
+    int textureWidth = 0;
+    int textureHeight = 0;
+    bool jScansPositively = false;
+
+    Clock::time_point nextDue;
+    Clock::time_point playStart;
+    double decodeTotal = 0.;
+    double renderTotal = 0.;
+    double uploadTotal = 0.;
+    AnimationStats stat;
+};
@@ -0,0 +1,556 @@
+// GribBatch: headless PNG production. Same colour path and PNG writer as the
+// viewer's export, without a window or GL context.
+//
+//   GribBatch [options] file.grib [file.grib ...]
+//
+// Messages are rendered and encoded in parallel; a per-stage timing summary is
+// printed at the end.
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "export_animation.h"
+#include "export_grib.h"
+#include "export_image.h"
+#include "export_values.h"
+#include "field_render.h"
+#include "grib_collection.h"
+#include "settings.h"
+#include "task_scheduler.h"
+#include "trace.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point t0) {
+    return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+// key=value; value may list alternatives separated by '/', e.g. level=500/850
+struct FilterTerm {
+    std::string key;
+    std::vector<std::string> values;
+};
+
+struct BatchOptions {
+    std::vector<std::string> files;
+    std::vector<FilterTerm> filter;
+    std::string outDir = ".";
+    int threads = 0;
+    int scale = 1;
+    int upscale = 1;
+    bool listOnly = false;
+    std::string animation;
+    std::string grib;  // copy the selected messages here instead of rendering
+    float fps = 4.f;
+    PngLevel pngLevel = PngLevel::Default;
+    bool palette = false;
+    std::string values;  // "npy" or "bin": dump decoded values instead of images
+    bool float32 = false;
+    GribViewerSettings settings;
+};
+
+struct StageTimes {
+    double read = 0.;
+    double decode = 0.;
+    double render = 0.;
+    double encode = 0.;
+};
+
+void printUsage(const char* argv0) {
+    std::printf(
+        "Usage: %s [options] file.grib [file.grib ...]\n"
+        "\n"
+        "  -o DIR               output directory (default .)\n"
+        "  -f KEY=V[/V...]      message filter, repeatable; KEY is one of shortName,\n"
+        "                       name, typeOfLevel, level, step, perturbationNumber,\n"
+        "                       discipline, parameterCategory, parameterNumber,\n"
+        "                       indicatorOfParameter\n"
+        "  -g NAME              colormap (default %s)\n"
+        "  --min V --max V      fixed colour range\n"
+        "  --symmetric          colour range symmetric around zero, per field\n"
+        "  --sqrt               sqrt scaling\n"
+        "  --discrete N         N discrete colours\n"
+        "  --brightness V  --gamma V  --vibrancy V  --hue-shift V\n"
+        "  --missing-color RRGGBB  colour of points without a value (default 808080)\n"
+        "  --scale N            downsample the image N times in each direction\n"
+        "  --upscale N          enlarge N times, rendered and written in bands\n"
+        "  -a FILE              write the selected messages, in step order, as one\n"
+        "                       animation: .png (APNG), .gif or .y4m\n"
+        "  --fps V              animation frame rate (default 4)\n"
+        "  --png-level L        fastest, fast, default or smallest\n"
+        "  --palette            8-bit palette PNGs straight from the colormap\n"
+        "  --grib FILE          copy the selected messages' original bytes to FILE\n"
+        "  --values npy|bin     write the decoded values instead of images: NumPy\n"
+        "                       arrays, or raw binary after a JSON header line\n"
+        "  --float32            values as float32 (default float64)\n"
+        "  -j N                 worker threads (default: all cores)\n"
+        "  -l                   list matching messages, render nothing\n",
+        argv0, GradientRegistry::instance().name(0));
+}
+
+bool parseFloat(const char* s, float& out) {
+    char* end = nullptr;
+    out = std::strtof(s, &end);
+    return end != s && *end == '\0';
+}
+
+bool parseInt(const char* s, int& out) {
+    char* end = nullptr;
+    long v = std::strtol(s, &end, 10);
+    out = static_cast<int>(v);
+    return end != s && *end == '\0';
+}
+
+// RRGGBB, optionally with a leading '#'.
+bool parseHexColor(const char* s, Color& out) {
+    if (*s == '#') ++s;
+    if (std::strlen(s) != 6) return false;
+    char* end = nullptr;
+    unsigned long rgb = std::strtoul(s, &end, 16);
+    if (*end != '\0') return false;
+    out = Color(((rgb >> 16) & 0xff) / 255.f, ((rgb >> 8) & 0xff) / 255.f, (rgb & 0xff) / 255.f);
+    return true;
+}
+
+bool parseFilter(const std::string& arg, std::vector<FilterTerm>& filter) {
+    size_t eq = arg.find('=');
+    if (eq == std::string::npos || eq == 0) return false;
+    FilterTerm term;
+    term.key = arg.substr(0, eq);
+    size_t start = eq + 1;
+    while (true) {
+        size_t slash = arg.find('/', start);
+        term.values.push_back(arg.substr(start, slash - start));
+        if (slash == std::string::npos) break;
+        start = slash + 1;
+    }
+    filter.push_back(std::move(term));
+    return true;
+}
+
+bool parseArgs(int argc, char** argv, BatchOptions& opt) {
+    GribViewerSettings& s = opt.settings;
+    bool haveMin = false;
+    bool haveMax = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        auto next = [&]() -> const char* {
+            if (i + 1 >= argc) {
+                std::fprintf(stderr, "Missing value for %s\n", a.c_str());
+                return nullptr;
+            }
+            return argv[++i];
+        };
+        const char* v = nullptr;
+        int iv = 0;
+        if (a == "-h" || a == "--help") {
+            printUsage(argv[0]);
+            std::exit(0);
+        }
+        else if (a == "-l") {
+            opt.listOnly = true;
+        }
+        else if (a == "-o") {
+            if (!(v = next())) return false;
+            opt.outDir = v;
+        }
+        else if (a == "-a") {
+            if (!(v = next())) return false;
+            opt.animation = v;
+        }
+        else if (a == "--fps") {
+            if (!(v = next()) || !parseFloat(v, opt.fps) || opt.fps <= 0.f) return false;
+        }
+        else if (a == "--png-level") {
+            if (!(v = next())) return false;
+            if (!pngLevelFromName(v, opt.pngLevel)) {
+                std::fprintf(stderr, "Unknown PNG level '%s'\n", v);
+                return false;
+            }
+        }
+        else if (a == "--palette") {
+            opt.palette = true;
+        }
+        else if (a == "-f") {
+            if (!(v = next())) return false;
+            if (!parseFilter(v, opt.filter)) {
+                std::fprintf(stderr, "Bad filter '%s', expected KEY=VALUE\n", v);
+                return false;
+            }
+        }
+        else if (a == "-g") {
+            if (!(v = next())) return false;
+            s.gradient = GradientRegistry::instance().find(v);
+            if (s.gradient == invalidGradient) {
+                std::fprintf(stderr, "Unknown colormap '%s'\n", v);
+                return false;
+            }
+        }
+        else if (a == "--min") {
+            if (!(v = next()) || !parseFloat(v, s.minVal)) return false;
+            haveMin = true;
+        }
+        else if (a == "--max") {
+            if (!(v = next()) || !parseFloat(v, s.maxVal)) return false;
+            haveMax = true;
+        }
+        else if (a == "--symmetric") {
+            s.symmetricAroundZero = true;
+        }
+        else if (a == "--sqrt") {
+            s.sqrtScale = true;
+        }
+        else if (a == "--discrete") {
+            if (!(v = next()) || !parseInt(v, iv) || iv < 2) return false;
+            s.discreteColors = true;
+            s.colorCount = static_cast<size_t>(iv);
+        }
+        else if (a == "--brightness") {
+            if (!(v = next()) || !parseFloat(v, s.brightness)) return false;
+        }
+        else if (a == "--gamma") {
+            if (!(v = next()) || !parseFloat(v, s.gamma)) return false;
+        }
+        else if (a == "--vibrancy") {
+            if (!(v = next()) || !parseFloat(v, s.vibrancy)) return false;
+        }
+        else if (a == "--hue-shift") {
+            if (!(v = next()) || !parseFloat(v, s.hueShift)) return false;
+        }
+        else if (a == "--missing-color") {
+            if (!(v = next()) || !parseHexColor(v, s.missingColor)) return false;
+        }
+        else if (a == "--scale") {
+            if (!(v = next()) || !parseInt(v, opt.scale) || opt.scale < 1) return false;
+        }
+        else if (a == "--upscale") {
+            if (!(v = next()) || !parseInt(v, opt.upscale) || opt.upscale < 1) return false;
+        }
+        else if (a == "--grib") {
+            if (!(v = next())) return false;
+            opt.grib = v;
+        }
+        else if (a == "--values") {
+            if (!(v = next())) return false;
+            opt.values = v;
+            ValuesFormat format;
+            if (!valuesFormatFromName("." + opt.values, format)) {
+                std::fprintf(stderr, "Unknown values format '%s'\n", v);
+                return false;
+            }
+        }
+        else if (a == "--float32") {
+            opt.float32 = true;
+        }
+        else if (a == "-j") {
+            if (!(v = next()) || !parseInt(v, opt.threads) || opt.threads < 1) return false;
+        }
+        else if (!a.empty() && a[0] == '-') {
+            std::fprintf(stderr, "Unknown option %s\n", a.c_str());
+            return false;
+        }
+        else {
+            opt.files.push_back(a);
+        }
+    }
+    if (haveMin != haveMax) {
+        std::fprintf(stderr, "--min and --max must be given together\n");
+        return false;
+    }
+    if (haveMin && s.symmetricAroundZero) {
+        std::fprintf(stderr, "--min/--max and --symmetric are exclusive\n");
+        return false;
+    }
+    if (!opt.values.empty() && !opt.animation.empty()) {
+        std::fprintf(stderr, "--values and -a are exclusive\n");
+        return false;
+    }
+    if (opt.upscale > 1 && (opt.scale > 1 || !opt.animation.empty())) {
+        std::fprintf(stderr, "--upscale is for single images and excludes --scale\n");
+        return false;
+    }
+    if (!opt.animation.empty() && s.symmetricAroundZero) {
+        std::fprintf(stderr, "--symmetric is per field; give --min/--max for an animation\n");
+        return false;
+    }
+    s.useCustomMinMax = haveMin;
+    return !opt.files.empty();
+}
+
+bool matchLong(long v, const std::vector<std::string>& values) {
+    for (const auto& s : values) {
+        char* end = nullptr;
+        long x = std::strtol(s.c_str(), &end, 10);
+        if (end != s.c_str() && *end == '\0' && x == v) return true;
+    }
+    return false;
+}
+
+bool matchString(const std::string& v, const std::vector<std::string>& values) {
+    return std::find(values.begin(), values.end(), v) != values.end();
+}
+
+bool matches(const GribMessageInfo& m, const std::vector<FilterTerm>& filter, bool& badKey) {
+    for (const auto& t : filter) {
+        bool ok;
+        if (t.key == "shortName") ok = matchString(m.shortName, t.values);
+        else if (t.key == "name") ok = matchString(m.name, t.values);
+        else if (t.key == "typeOfLevel") ok = matchString(m.typeOfLevel, t.values);
+        else if (t.key == "level") ok = matchLong(m.level, t.values);
+        else if (t.key == "step") ok = matchLong(m.step, t.values);
+        else if (t.key == "perturbationNumber") ok = matchLong(m.perturbationNumber, t.values);
+        else if (t.key == "discipline") ok = matchLong(m.discipline, t.values);
+        else if (t.key == "parameterCategory") ok = matchLong(m.parameterCategory, t.values);
+        else if (t.key == "parameterNumber") ok = matchLong(m.parameterNumber, t.values);
+        else if (t.key == "indicatorOfParameter") ok = matchLong(m.indicatorOfParameter, t.values);
+        else {
+            badKey = true;
+            return false;
+        }
+        if (!ok) return false;
+    }
+    return true;
+}
+
+// 00012_t_isobaricInhPa850_step6.png, plus _mN for ensemble members
+std::string outputName(const BatchOptions& opt, const GribMessageInfo& m) {
+    char buf[512];
+    std::string shortName = m.shortName;
+    std::replace(shortName.begin(), shortName.end(), '/', '_');
+    int n = std::snprintf(buf, sizeof(buf), "%05zu_%s_%s%ld_step%ld",
+        m.globalIndex, shortName.c_str(), m.typeOfLevel.c_str(), m.level, m.step);
+    if (m.perturbationNumber >= 0 && n > 0 && static_cast<size_t>(n) < sizeof(buf))
+        std::snprintf(buf + n, sizeof(buf) - n, "_m%ld", m.perturbationNumber);
+    return opt.outDir + "/" + buf + "." + (opt.values.empty() ? "png" : opt.values);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BatchOptions opt;
+    if (!parseArgs(argc, argv, opt)) {
+        printUsage(argv[0]);
+        return 2;
+    }
+    if (opt.threads > 0) TaskScheduler::setWorkerCount(opt.threads - 1);
+    Tracer::instance().initFromEnv();
+
+    Clock::time_point wallStart = Clock::now();
+
+    GribCollection collection;
+    collection.beginLoad(opt.files);
+    while (collection.loadNext()) {}
+    if (collection.messageCount() == 0) {
+        std::fprintf(stderr, "No GRIB messages found\n");
+        return 1;
+    }
+    double scanSeconds = secondsSince(wallStart);
+
+    std::vector<size_t> selected;
+    for (const auto& m : collection.messageList) {
+        bool badKey = false;
+        if (matches(m, opt.filter, badKey)) selected.push_back(m.globalIndex);
+        if (badKey) {
+            std::fprintf(stderr, "Unknown filter key\n");
+            return 2;
+        }
+    }
+
+    if (opt.listOnly) {
+        for (size_t g : selected)
+            std::printf("%s\n", outputName(opt, collection.messageList[g]).c_str());
+        return 0;
+    }
+
+    if (!opt.grib.empty()) {
+        Clock::time_point copyStart = Clock::now();
+        GribCopyStats stats;
+        if (!saveMessagesAsGrib(opt.grib, collection, selected, &stats)) {
+            std::fprintf(stderr, "Failed to write %s\n", opt.grib.c_str());
+            return 1;
+        }
+        double seconds = secondsSince(copyStart);
+        std::printf("%zu messages in %zu ranges, %.1f MB in %.3f s (%.0f MB/s)\n",
+            stats.messages, stats.ranges, stats.bytes / 1e6, seconds,
+            seconds > 0. ? stats.bytes / 1e6 / seconds : 0.);
+        return 0;
+    }
+
+    if (!opt.animation.empty()) {
+        AnimationExportOptions anim;
+        if (!animationFormatFromName(opt.animation, anim.format)) {
+            std::fprintf(stderr, "Unknown animation format: %s\n", opt.animation.c_str());
+            return 2;
+        }
+        anim.fps = opt.fps;
+        anim.scale = opt.scale;
+        anim.pngLevel = opt.pngLevel;
+        std::stable_sort(selected.begin(), selected.end(), [&](size_t a, size_t b) {
+            const GribMessageInfo& ma = collection.messageList[a];
+            const GribMessageInfo& mb = collection.messageList[b];
+            if (ma.step != mb.step) return ma.step < mb.step;
+            if (ma.validityDate != mb.validityDate) return ma.validityDate < mb.validityDate;
+            return ma.validityTime < mb.validityTime;
+        });
+        std::printf("Writing %zu frames to %s\n", selected.size(), opt.animation.c_str());
+        bool ok = exportAnimation(opt.animation, collection, selected, opt.settings, anim);
+        std::printf("%s in %.3f s\n", ok ? "done" : "failed", secondsSince(wallStart));
+        Tracer::instance().writeEnvTrace();
+        return ok ? 0 : 1;
+    }
+
+    std::printf("%zu of %zu messages selected, %u threads\n",
+        selected.size(), collection.messageCount(), TaskScheduler::instance().concurrency());
+
+    // Stage times are summed over threads, so they are CPU seconds per stage.
+    StageTimes total;
+    size_t pixels = 0;
+    int failures = 0;
+    std::mutex totalMutex;
+    // Buffers are reused across messages. They are handed out from a free list
+    // rather than per thread: a thread waiting inside colorizeField may pick up
+    // another message before its own is done.
+    struct Scratch {
+        std::vector<unsigned char> bytes;
+        std::vector<Color> img;
+        std::vector<unsigned char> indices;
+        GribField field;
+    };
+    std::vector<std::unique_ptr<Scratch>> scratchPool;
+    Clock::time_point renderStart = Clock::now();
+
+    parallelFor(0, static_cast<long>(selected.size()), [&](long i) {
+        const GribMessageInfo& m = collection.messageList[selected[i]];
+        auto [fileIdx, indexInFile] = collection.lookupByGlobal[m.globalIndex];
+        const GribReader& reader = *collection.readers[fileIdx];
+        GribViewerSettings settings = opt.settings;
+        StageTimes local;
+        bool ok = false;
+        size_t imagePixels = 0;
+
+        std::unique_ptr<Scratch> scratch;
+        {
+            std::lock_guard<std::mutex> lock(totalMutex);
+            if (!scratchPool.empty()) {
+                scratch = std::move(scratchPool.back());
+                scratchPool.pop_back();
+            }
+        }
+        if (!scratch) scratch = std::make_unique<Scratch>();
+        std::vector<Color>& img = scratch->img;
+        GribField& field = scratch->field;
+
+        Clock::time_point t0 = Clock::now();
+        if (!reader.readMessage(indexInFile, scratch->bytes)) {
+            std::fprintf(stderr, "Failed to read message %zu\n", m.globalIndex);
+        } else {
+            Clock::time_point t1 = Clock::now();
+            ok = reader.readFieldFromMessage(scratch->bytes, field, false);
+            Clock::time_point t2 = Clock::now();
+            local.read = std::chrono::duration<double>(t1 - t0).count();
+            local.decode = std::chrono::duration<double>(t2 - t1).count();
+            if (!ok) std::fprintf(stderr, "Failed to read message %zu\n", m.globalIndex);
+        }
+
+        if (ok && !opt.values.empty()) {
+            Clock::time_point t2 = Clock::now();
+            std::string out = outputName(opt, m);
+            ValuesFormat format;
+            valuesFormatFromName(out, format);
+            ok = exportFieldValues(out, field, &m, format,
+                opt.float32 ? ValuesType::Float32 : ValuesType::Float64);
+            local.encode = secondsSince(t2);
+            imagePixels = field.values.size();
+            if (!ok) std::fprintf(stderr, "Failed to write %s\n", out.c_str());
+        } else if (ok) {
+            if (settings.symmetricAroundZero) {
+                float absMax = std::max(std::abs(field.min_value), std::abs(field.max_value));
+                settings.minVal = -absMax;
+                settings.maxVal = absMax;
+            }
+            int w = std::max(1L, field.width / opt.scale);
+            int h = std::max(1L, field.height / opt.scale);
+            Clock::time_point t2 = Clock::now();
+            ColorizeStatus status;
+            if (opt.upscale > 1) {
+                status = ColorizeStatus::Ok;  // checked per band
+            } else if (opt.palette) {
+                status = colorizeFieldIndexed(field, w, h, settings, scratch->indices);
+            } else {
+                img.resize(static_cast<size_t>(w) * h);
+                status = colorizeField(field, w, h, settings, img);
+            }
+            Clock::time_point t3 = Clock::now();
+            local.render = std::chrono::duration<double>(t3 - t2).count();
+            imagePixels = static_cast<size_t>(w) * h;
+            if (status != ColorizeStatus::Ok) {
+                std::fprintf(stderr, "Message %zu: %s\n", m.globalIndex,
+                    status == ColorizeStatus::NoData ? "no data" : "invalid min/max");
+                ok = false;
+            } else {
+                std::string out = outputName(opt, m);
+                if (opt.upscale > 1) {
+                    // colouring overlaps encoding, so both count as encode
+                    const long uw = field.width * opt.upscale;
+                    const long uh = field.height * opt.upscale;
+                    BandedExportOptions banded;
+                    banded.palette = opt.palette;
+                    banded.level = opt.pngLevel;
+                    ok = uw <= INT_MAX && uh <= INT_MAX &&
+                         exportFieldPngBanded(out, field, static_cast<int>(uw),
+                                              static_cast<int>(uh), settings, banded);
+                    imagePixels = static_cast<size_t>(uw) * uh;
+                } else if (opt.palette) {
+                    std::vector<unsigned char> palette;
+                    colormapPalette(settings, palette);
+                    ok = exportImagePngIndexed(out, w, h, scratch->indices, palette,
+                                               field.jScansPositively, opt.pngLevel);
+                } else {
+                    ok = exportImagePng(out, w, h, img, field.jScansPositively, opt.pngLevel);
+                }
+                local.encode = secondsSince(t3);
+                if (!ok) std::fprintf(stderr, "Failed to write %s\n", out.c_str());
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(totalMutex);
+        total.read += local.read;
+        total.decode += local.decode;
+        total.render += local.render;
+        total.encode += local.encode;
+        if (ok) pixels += imagePixels;
+        else ++failures;
+        scratchPool.push_back(std::move(scratch));
+    }, TaskPriority::Interactive, 1);
+
+    double renderWall = secondsSince(renderStart);
+    double wall = secondsSince(wallStart);
+    size_t written = selected.size() - failures;
+    double cpu = total.read + total.decode + total.render + total.encode;
+    auto pct = [cpu](double t) { return cpu > 0. ? 100. * t / cpu : 0.; };
+
+    std::printf("\n%zu images written, %d failed\n", written, failures);
+    std::printf("  scan     %8.3f s (wall)\n", scanSeconds);
+    std::printf("  read     %8.3f s cpu  %5.1f%%\n", total.read, pct(total.read));
+    std::printf("  decode   %8.3f s cpu  %5.1f%%\n", total.decode, pct(total.decode));
+    std::printf("  render   %8.3f s cpu  %5.1f%%\n", total.render, pct(total.render));
+    std::printf("  encode   %8.3f s cpu  %5.1f%%\n", total.encode, pct(total.encode));
+    std::printf("  render+encode wall %.3f s, total wall %.3f s\n", renderWall, wall);
+    if (renderWall > 0.)
+        std::printf("  %.1f images/s, %.1f Mpixel/s\n",
+            written / renderWall, pixels / renderWall / 1e6);
+
+    Tracer::instance().writeEnvTrace();
+    return failures == 0 ? 0 : 1;
+}
@@ -89,35 +89,3 @@ inline Color applyHclAdjustments(const Color& srgb,
                  std::clamp(bl, 0.0f, 1.0f));
     return linear2srgb(linOut);
 }
-
-inline void rebuildGradientPreview(Gradient& grad,
-                                   float brightness,
-                                   float gamma,
-                                   float vibrancy,
-                                   float hueShift) {
-    constexpr int previewWidth = 256;
-    constexpr int previewHeight = 16;
-    if (grad.previewData.size() != static_cast<size_t>(previewWidth * previewHeight))
-        grad.previewData.resize(previewWidth * previewHeight);
-
-    for (int x = 0; x < previewWidth; ++x) {
-        float t = static_cast<float>(x) / (previewWidth - 1);
-        Color col = applyHclAdjustments(grad.get_color(t), brightness, gamma, vibrancy, hueShift);
-        for (int y = 0; y < previewHeight; ++y)
-            grad.previewData[y * previewWidth + x] = col;
-    }
-
-    bool newTexture = (grad.previewTexture == 0);
-    if (newTexture) glGenTextures(1, &grad.previewTexture);
-
-    glBindTexture(GL_TEXTURE_2D, grad.previewTexture);
-    if (newTexture) {
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, previewWidth, previewHeight, 0, GL_RGB, GL_FLOAT, nullptr);
-    }
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, previewWidth, previewHeight, GL_RGB, GL_FLOAT, grad.previewData.data());
-    glBindTexture(GL_TEXTURE_2D, 0);
-}
@@ -0,0 +1,79 @@
+#include "eccodes_warmup.h"
+
+#include <atomic>
+#include <mutex>
+
+#include "grib_reader.h"
+#include "task_scheduler.h"
+#include "trace.h"
+
+namespace {
+
+// GRIB1: ECMWF 2 m temperature (table 128, parameter 167), 2x2 lat/lon grid,
+// simple packing, 88 bytes
+const unsigned char grib1Sample[] = {
+    0x47, 0x52, 0x49, 0x42, 0x00, 0x00, 0x58, 0x01, 0x00, 0x00, 0x1c, 0x80, 0x62, 0x00, 0xff, 0x80,
+    0xa7, 0x01, 0x00, 0x00, 0x18, 0x01, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x15, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00, 0xff, 0x00, 0x00, 0x02, 0x00, 0x02, 0x00, 0x03,
+    0xe8, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x03, 0xe8, 0x03, 0xe8, 0x03, 0xe8, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x08, 0x00, 0x00, 0x43, 0x11, 0x10, 0x00, 0x08, 0x00,
+    0x01, 0x02, 0x03, 0x00, 0x37, 0x37, 0x37, 0x37,
+};
+// GRIB2: 2 m temperature (0/0/0 at 2 m above ground), 2x2 lat/lon grid,
+// simple packing, 183 bytes
+const unsigned char grib2Sample[] = {
+    0x47, 0x52, 0x49, 0x42, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xb7,
+    0x00, 0x00, 0x00, 0x15, 0x01, 0x00, 0x62, 0x00, 0x00, 0x04, 0x00, 0x01, 0x07, 0xe8, 0x01, 0x01,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x48, 0x03, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00,
+    0x00, 0x00, 0x00, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0xff,
+    0xff, 0xff, 0xff, 0x00, 0x0f, 0x42, 0x40, 0x00, 0x00, 0x00, 0x00, 0x30, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x0f, 0x42, 0x40, 0x00, 0x0f, 0x42, 0x40, 0x00, 0x0f, 0x42, 0x40, 0x00, 0x00, 0x00, 0x00,
+    0x22, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0xff, 0x00, 0x00, 0x00, 0x01, 0x00,
+    0x00, 0x00, 0x00, 0x67, 0x00, 0x00, 0x00, 0x00, 0x02, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00,
+    0x00, 0x00, 0x15, 0x05, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x43, 0x88, 0x80, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x06, 0x06, 0xff, 0x00, 0x00, 0x00, 0x09, 0x07, 0x00,
+    0x01, 0x02, 0x03, 0x37, 0x37, 0x37, 0x37,
+};
+
+std::once_flag warmupOnce;
+std::atomic<bool> warmupStarted{false};
+std::atomic<double> warmupMs{-1.0};
+
+void decodeSample(const unsigned char* data, size_t size) {
+    codes_handle* h = codes_handle_new_from_message(nullptr, data, size);
+    if (!h) return;
+    // the keys decodeMetadata resolves are the concepts (name, shortName,
+    // units, typeOfLevel, stepType) that load the most definition files
+    GribReader reader;
+    GribMessageInfo info;
+    reader.decodeMetadata(h, info);
+    GribField field;
+    reader.decodeField(h, field, false);
+    codes_handle_delete(h);
+}
+
+void runWarmup() {
+    TRACE_SCOPE("eccodesWarmup", "startup");
+    const uint64_t begin = Tracer::nowNs();
+    decodeSample(grib1Sample, sizeof(grib1Sample));
+    decodeSample(grib2Sample, sizeof(grib2Sample));
+    warmupMs.store((Tracer::nowNs() - begin) * 1e-6);
+}
+
+} // namespace
+
+void startEccodesWarmup() {
+    if (warmupStarted.exchange(true)) return;
+    TaskScheduler::instance().submit(TaskPriority::Background,
+                                     []() { std::call_once(warmupOnce, runWarmup); });
+}
+
+void waitEccodesWarmup() {
+    // the first scan would pay the same cost, so there is nothing to overlap
+    if (warmupStarted.load()) std::call_once(warmupOnce, runWarmup);
+}
+
+double eccodesWarmupMs() {
+    return warmupMs.load();
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+// ecCodes parses its definition and concept files lazily, on the first decode
+// in the process. The warm-up decodes a tiny embedded GRIB1 and GRIB2 message
+// on a background task, so that cost overlaps window and GL setup instead of
+// delaying the first file open.
+void startEccodesWarmup();
+// Returns once a started warm-up has finished, running it on the calling
+// thread if no worker has picked it up yet. Without a start, returns at once.
+void waitEccodesWarmup();
+// Duration of the warm-up, or a negative value while it has not finished.
+double eccodesWarmupMs();
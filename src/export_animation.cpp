@@ -0,0 +1,416 @@
+#include "export_animation.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+#include "export_image.h"
+#include "field_render.h"
+#include "png_encoder.h"
+#include "task_scheduler.h"
+#include "trace.h"
+
+namespace {
+
+// ---- PNG / APNG ----
+
+void putBE32(std::vector<unsigned char>& out, uint32_t v) {
+    out.push_back(static_cast<unsigned char>(v >> 24));
+    out.push_back(static_cast<unsigned char>(v >> 16));
+    out.push_back(static_cast<unsigned char>(v >> 8));
+    out.push_back(static_cast<unsigned char>(v));
+}
+
+void putBE16(std::vector<unsigned char>& out, uint16_t v) {
+    out.push_back(static_cast<unsigned char>(v >> 8));
+    out.push_back(static_cast<unsigned char>(v));
+}
+
+void putLE16(std::vector<unsigned char>& out, uint16_t v) {
+    out.push_back(static_cast<unsigned char>(v));
+    out.push_back(static_cast<unsigned char>(v >> 8));
+}
+
+void apngFrame(const std::vector<unsigned char>& rgb, int width, int height, int index,
+               float fps, PngLevel level, std::vector<unsigned char>& out) {
+    const size_t stride = static_cast<size_t>(width) * 3;
+    std::vector<unsigned char> filtered((stride + 1) * height);
+    for (int y = 0; y < height; ++y) {
+        const unsigned char* row = rgb.data() + y * stride;
+        pngFilterRow(row, y > 0 ? row - stride : nullptr, stride, 3, level, false,
+                     filtered.data() + y * (stride + 1));
+    }
+    std::vector<unsigned char> z;
+    pngDeflate(filtered.data(), filtered.size(), level, false, z);
+
+    std::vector<unsigned char> body;
+    putBE32(body, index == 0 ? 0 : 2 * index - 1);  // sequence number
+    putBE32(body, width);
+    putBE32(body, height);
+    putBE32(body, 0);
+    putBE32(body, 0);
+    putBE16(body, static_cast<uint16_t>(std::lround(1000.f / fps)));
+    putBE16(body, 1000);
+    body.push_back(0);  // dispose: none
+    body.push_back(0);  // blend: source
+    appendPngChunk(out, "fcTL", body);
+
+    body.clear();
+    if (index > 0) putBE32(body, 2 * index);
+    body.insert(body.end(), z.begin(), z.end());
+    appendPngChunk(out, index == 0 ? "IDAT" : "fdAT", body);
+}
+
+void apngHeader(int width, int height, int frames, bool loop, std::vector<unsigned char>& out) {
+    static const unsigned char signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    out.insert(out.end(), signature, signature + 8);
+    std::vector<unsigned char> body;
+    putBE32(body, width);
+    putBE32(body, height);
+    body.insert(body.end(), {8, 2, 0, 0, 0});  // 8-bit RGB
+    appendPngChunk(out, "IHDR", body);
+    body.clear();
+    putBE32(body, frames);
+    putBE32(body, loop ? 0 : 1);  // plays; 0 repeats forever
+    appendPngChunk(out, "acTL", body);
+}
+
+// ---- GIF ----
+
+void flipRows(std::vector<unsigned char>& pixels, int width, int height) {
+    for (int y = 0; y < height / 2; ++y)
+        std::swap_ranges(pixels.begin() + static_cast<size_t>(y) * width,
+                         pixels.begin() + static_cast<size_t>(y + 1) * width,
+                         pixels.begin() + static_cast<size_t>(height - 1 - y) * width);
+}
+
+// Variable-width LZW codes, least significant bit first, in <= 255 byte blocks.
+class GifLzw {
+public:
+    explicit GifLzw(std::vector<unsigned char>& out) : out(out) {}
+
+    void encode(const std::vector<unsigned char>& indices) {
+        out.push_back(minCodeSize);
+        reset();
+        put(clearCode);
+        int prefix = indices[0];
+        for (size_t i = 1; i < indices.size(); ++i) {
+            const int c = indices[i];
+            const int key = (prefix << 8) | c;
+            int slot = find(key);
+            if (keys[slot] == key) {
+                prefix = codes[slot];
+                continue;
+            }
+            put(prefix);
+            if (maxCode < 4095) {
+                keys[slot] = key;
+                codes[slot] = static_cast<uint16_t>(++maxCode);
+                if (maxCode >= (1 << codeSize)) ++codeSize;
+            } else {
+                put(clearCode);
+                reset();
+            }
+            prefix = c;
+        }
+        put(prefix);
+        // the decoder adds an entry for the last code before reading the next
+        if (maxCode + 1 >= (1 << codeSize) && codeSize < 12) ++codeSize;
+        put(clearCode + 1);
+        if (bits > 0) block.push_back(static_cast<unsigned char>(acc));
+        flushBlock();
+        out.push_back(0);
+    }
+
+private:
+    static constexpr int minCodeSize = 8;
+    static constexpr int clearCode = 1 << minCodeSize;
+    static constexpr int tableSize = 5003;  // prime, > 4096
+
+    void reset() {
+        keys.assign(tableSize, -1);
+        codes.assign(tableSize, 0);
+        codeSize = minCodeSize + 1;
+        maxCode = clearCode + 1;
+    }
+
+    int find(int key) const {
+        int slot = static_cast<int>((static_cast<unsigned>(key) * 2654435761u) % tableSize);
+        while (keys[slot] != -1 && keys[slot] != key) slot = (slot + 1) % tableSize;
+        return slot;
+    }
+
+    void put(int code) {
+        acc |= static_cast<uint32_t>(code) << bits;
+        bits += codeSize;
+        while (bits >= 8) {
+            block.push_back(static_cast<unsigned char>(acc));
+            acc >>= 8;
+            bits -= 8;
+            if (block.size() == 255) flushBlock();
+        }
+    }
+
+    void flushBlock() {
+        if (block.empty()) return;
+        out.push_back(static_cast<unsigned char>(block.size()));
+        out.insert(out.end(), block.begin(), block.end());
+        block.clear();
+    }
+
+    std::vector<unsigned char>& out;
+    std::vector<unsigned char> block;
+    std::vector<int> keys;
+    std::vector<uint16_t> codes;
+    uint32_t acc = 0;
+    int bits = 0;
+    int codeSize = 0;
+    int maxCode = 0;
+};
+
+void gifFrame(const std::vector<unsigned char>& indices, int width, int height, float fps,
+              std::vector<unsigned char>& out) {
+    // graphic control extension: frame delay in 1/100 s
+    out.insert(out.end(), {0x21, 0xF9, 0x04, 0x04});
+    putLE16(out, static_cast<uint16_t>(std::max(2L, std::lround(100.f / fps))));
+    out.insert(out.end(), {0x00, 0x00});
+    // image descriptor, no local colour table
+    out.push_back(0x2C);
+    putLE16(out, 0);
+    putLE16(out, 0);
+    putLE16(out, static_cast<uint16_t>(width));
+    putLE16(out, static_cast<uint16_t>(height));
+    out.push_back(0x00);
+
+    GifLzw(out).encode(indices);
+}
+
+void gifHeader(int width, int height, bool loop, const std::vector<unsigned char>& palette,
+               std::vector<unsigned char>& out) {
+    static const char signature[] = "GIF89a";
+    out.insert(out.end(), signature, signature + 6);
+    putLE16(out, static_cast<uint16_t>(width));
+    putLE16(out, static_cast<uint16_t>(height));
+    out.insert(out.end(), {0xF7, 0x00, 0x00});  // 256-entry global colour table
+    out.insert(out.end(), palette.begin(), palette.end());
+    if (loop) {
+        static const char app[] = "NETSCAPE2.0";
+        out.insert(out.end(), {0x21, 0xFF, 0x0B});
+        out.insert(out.end(), app, app + 11);
+        out.insert(out.end(), {0x03, 0x01, 0x00, 0x00, 0x00});
+    }
+}
+
+// ---- Y4M ----
+
+// BT.601 limited range, chroma averaged over 2x2 blocks.
+void y4mFrame(const std::vector<unsigned char>& rgb, int width, int height,
+              std::vector<unsigned char>& out) {
+    static const char tag[] = "FRAME\n";
+    out.insert(out.end(), tag, tag + 6);
+    const size_t yPos = out.size();
+    const int cw = (width + 1) / 2, ch = (height + 1) / 2;
+    out.resize(yPos + static_cast<size_t>(width) * height + 2 * static_cast<size_t>(cw) * ch);
+    unsigned char* yPlane = out.data() + yPos;
+    unsigned char* uPlane = yPlane + static_cast<size_t>(width) * height;
+    unsigned char* vPlane = uPlane + static_cast<size_t>(cw) * ch;
+    auto clamp8 = [](float v) {
+        return static_cast<unsigned char>(std::clamp(v + 0.5f, 0.f, 255.f));
+    };
+    for (size_t i = 0; i < static_cast<size_t>(width) * height; ++i) {
+        const float r = rgb[i * 3] / 255.f, g = rgb[i * 3 + 1] / 255.f, b = rgb[i * 3 + 2] / 255.f;
+        yPlane[i] = clamp8(16.f + 65.481f * r + 128.553f * g + 24.966f * b);
+    }
+    for (int cy = 0; cy < ch; ++cy) {
+        for (int cx = 0; cx < cw; ++cx) {
+            float r = 0.f, g = 0.f, b = 0.f;
+            int n = 0;
+            for (int y = 2 * cy; y < std::min(height, 2 * cy + 2); ++y) {
+                for (int x = 2 * cx; x < std::min(width, 2 * cx + 2); ++x) {
+                    const unsigned char* p = &rgb[(static_cast<size_t>(y) * width + x) * 3];
+                    r += p[0];
+                    g += p[1];
+                    b += p[2];
+                    ++n;
+                }
+            }
+            r /= 255.f * n;
+            g /= 255.f * n;
+            b /= 255.f * n;
+            const size_t c = static_cast<size_t>(cy) * cw + cx;
+            uPlane[c] = clamp8(128.f - 37.797f * r - 74.203f * g + 112.f * b);
+            vPlane[c] = clamp8(128.f + 112.f * r - 93.786f * g - 18.214f * b);
+        }
+    }
+}
+
+void y4mHeader(int width, int height, float fps, std::vector<unsigned char>& out) {
+    char buf[128];
+    int len = std::snprintf(buf, sizeof(buf), "YUV4MPEG2 W%d H%d F%ld:1000 Ip A1:1 C420jpeg\n",
+                            width, height, std::lround(fps * 1000.f));
+    out.insert(out.end(), buf, buf + len);
+}
+
+// ---- pipeline ----
+
+struct FrameSlot {
+    GribField field;
+    std::vector<unsigned char> scratch;
+    std::vector<Color> img;
+    std::vector<unsigned char> rgb;  // or palette indices for GIF
+    std::vector<unsigned char> bytes;  // encoded frame, ready to write
+    int width = 0;
+    int height = 0;
+};
+
+} // namespace
+
+bool animationFormatFromName(const std::string& filename, AnimationFormat& format) {
+    std::string ext = filename.substr(filename.find_last_of('.') + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    if (ext == "png" || ext == "apng") format = AnimationFormat::Apng;
+    else if (ext == "gif") format = AnimationFormat::Gif;
+    else if (ext == "y4m") format = AnimationFormat::Y4m;
+    else return false;
+    return true;
+}
+
+bool exportAnimation(const std::string& filename, const GribCollection& collection,
+    const std::vector<size_t>& series, const GribViewerSettings& settings,
+    const AnimationExportOptions& options, AnimationExportProgress* progress) {
+    TRACE_SCOPE("exportAnimation", "export");
+    const int count = static_cast<int>(series.size());
+    if (count == 0) return false;
+    if (progress) {
+        progress->done = 0;
+        progress->total = count;
+    }
+
+    FILE* f = std::fopen(filename.c_str(), "wb");
+    if (!f) {
+        std::fprintf(stderr, "Cannot write %s\n", filename.c_str());
+        return false;
+    }
+
+    TaskScheduler& scheduler = TaskScheduler::instance();
+    int window = options.window > 0 ? options.window
+                                    : 2 * static_cast<int>(scheduler.concurrency());
+    window = std::clamp(window, 1, count);
+    const float fps = std::clamp(options.fps, 0.5f, 100.f);
+    const int scale = std::max(1, options.scale);
+
+    std::vector<unsigned char> palette;
+    if (options.format == AnimationFormat::Gif) colormapPalette(settings, palette);
+
+    std::vector<std::unique_ptr<FrameSlot>> slots(window);
+    for (auto& s : slots) s = std::make_unique<FrameSlot>();
+
+    auto produce = [&](int index, int s) {
+        TRACE_SCOPE("animationFrame", "export");
+        FrameSlot* slot = slots[s].get();
+        if (!collection.readFieldAt(series[index], slot->field, slot->scratch, false))
+            return false;
+        slot->width = static_cast<int>(std::max(1L, slot->field.width / scale));
+        slot->height = static_cast<int>(std::max(1L, slot->field.height / scale));
+        slot->bytes.clear();
+        if (options.format == AnimationFormat::Gif) {
+            if (colorizeFieldIndexed(slot->field, slot->width, slot->height, settings,
+                                     slot->rgb) != ColorizeStatus::Ok)
+                return false;
+            if (slot->field.jScansPositively) flipRows(slot->rgb, slot->width, slot->height);
+            gifFrame(slot->rgb, slot->width, slot->height, fps, slot->bytes);
+            return true;
+        }
+        slot->img.resize(static_cast<size_t>(slot->width) * slot->height);
+        if (colorizeField(slot->field, slot->width, slot->height, settings,
+                          slot->img) != ColorizeStatus::Ok)
+            return false;
+        colorsToRgb8(slot->width, slot->height, slot->img,
+                     slot->field.jScansPositively, slot->rgb);
+        if (options.format == AnimationFormat::Apng)
+            apngFrame(slot->rgb, slot->width, slot->height, index, fps,
+                      options.pngLevel, slot->bytes);
+        else
+            y4mFrame(slot->rgb, slot->width, slot->height, slot->bytes);
+        return true;
+    };
+
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> header;
+    auto consume = [&](int i, int s, bool produced) {
+        const FrameSlot& slot = *slots[s];
+        if (progress && progress->cancel.load())
+            return false;
+        if (!produced) {
+            std::fprintf(stderr, "Failed to render message %zu\n", series[i]);
+            return false;
+        }
+
+        if (i == 0) {
+            width = slot.width;
+            height = slot.height;
+            if (options.format == AnimationFormat::Gif && (width > 65535 || height > 65535)) {
+                std::fprintf(stderr, "%dx%d is too large for GIF\n", width, height);
+                return false;
+            }
+            switch (options.format) {
+                case AnimationFormat::Apng: apngHeader(width, height, count, options.loop, header); break;
+                case AnimationFormat::Gif: gifHeader(width, height, options.loop, palette, header); break;
+                case AnimationFormat::Y4m: y4mHeader(width, height, fps, header); break;
+            }
+            if (std::fwrite(header.data(), 1, header.size(), f) != header.size())
+                return false;
+        } else if (slot.width != width || slot.height != height) {
+            std::fprintf(stderr, "Message %zu is %dx%d, the animation %dx%d\n", series[i],
+                         slot.width, slot.height, width, height);
+            return false;
+        }
+        if (std::fwrite(slot.bytes.data(), 1, slot.bytes.size(), f) != slot.bytes.size())
+            return false;
+        if (progress) progress->done = i + 1;
+        return true;
+    };
+    bool ok = orderedPipeline(count, window, TaskPriority::Background, produce, consume);
+
+    if (ok) {
+        std::vector<unsigned char> trailer;
+        if (options.format == AnimationFormat::Apng) appendPngChunk(trailer, "IEND", {});
+        else if (options.format == AnimationFormat::Gif) trailer.push_back(0x3B);
+        ok = std::fwrite(trailer.data(), 1, trailer.size(), f) == trailer.size();
+    }
+    ok = std::fclose(f) == 0 && ok;
+    if (!ok) std::remove(filename.c_str());
+    return ok;
+}
+
+bool AnimationExportJob::start(const std::string& filename, const GribCollection& collection,
+                               std::vector<size_t> frames, const GribViewerSettings& st,
+                               const AnimationExportOptions& opt, std::function<void()> onDone) {
+    if (running()) return false;
+    if (thread.joinable()) thread.join();
+    path = filename;
+    series = std::move(frames);
+    settings = st;
+    options = opt;
+    state.cancel = false;
+    state.done = 0;
+    state.total = static_cast<int>(series.size());
+    ok = false;
+    busy = true;
+    thread = std::thread([this, &collection, onDone = std::move(onDone)]() {
+        ok = exportAnimation(path, collection, series, settings, options, &state);
+        busy = false;
+        if (onDone) onDone();
+    });
+    return true;
+}
+
+void AnimationExportJob::cancel() {
+    state.cancel = true;
+    if (thread.joinable()) thread.join();
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "grib_collection.h"
+#include "png_encoder.h"
+#include "settings.h"
+
+enum class AnimationFormat {
+    Apng,
+    Gif,  // one 256-colour palette for all frames, from the colormap
+    Y4m   // raw 4:2:0 video for ffmpeg
+};
+
+struct AnimationExportOptions {
+    AnimationFormat format = AnimationFormat::Apng;
+    float fps = 4.f;
+    bool loop = true;
+    int scale = 1;   // downscale factor
+    int window = 0;  // frames in flight; 0 picks one from the thread count
+    PngLevel pngLevel = PngLevel::Default;  // APNG only
+};
+
+// Shared with the thread that shows progress; cancel makes the export stop
+// (and remove the partial file) after the frames in flight.
+struct AnimationExportProgress {
+    std::atomic<int> done{0};
+    std::atomic<int> total{0};
+    std::atomic<bool> cancel{false};
+};
+
+// Picks the format from the extension (.png/.apng, .gif, .y4m); false if unknown.
+bool animationFormatFromName(const std::string& filename, AnimationFormat& format);
+
+// Writes the messages of `series` as one animation. Frames are decoded and
+// coloured in parallel, at most `window` at a time, and streamed to the file
+// in order, so memory use does not grow with the length of the series. All
+// frames must have the same size. Returns false (and removes the file) on
+// failure or cancel.
+bool exportAnimation(const std::string& filename, const GribCollection& collection,
+    const std::vector<size_t>& series, const GribViewerSettings& settings,
+    const AnimationExportOptions& options, AnimationExportProgress* progress = nullptr);
+
+// exportAnimation on a thread of its own, for the viewer; its frames still go
+// through the task scheduler. The collection must stay loaded while running().
+class AnimationExportJob {
+public:
+    ~AnimationExportJob() { cancel(); }
+
+    // onDone runs on the export thread.
+    bool start(const std::string& filename, const GribCollection& collection,
+               std::vector<size_t> series, const GribViewerSettings& settings,
+               const AnimationExportOptions& options, std::function<void()> onDone = nullptr);
+    // Stops after the frames in flight and waits for the thread.
+    void cancel();
+
+    bool running() const { return busy.load(); }
+    bool succeeded() const { return ok.load(); }
+    const std::string& filename() const { return path; }
+    const AnimationExportProgress& progress() const { return state; }
+
+private:
+    std::thread thread;
+    std::atomic<bool> busy{false};
+    std::atomic<bool> ok{false};
+    std::string path;
+    std::vector<size_t> series;
+    GribViewerSettings settings;
+    AnimationExportOptions options;
+    AnimationExportProgress state;
+};
@@ -0,0 +1,145 @@
+#include "export_grib.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+namespace {
+
+struct ByteRange {
+    size_t fileIdx;
+    long offset;
+    size_t length;
+};
+
+bool unsupported(int err) {
+    return err == EXDEV || err == ENOSYS || err == EINVAL || err == EOPNOTSUPP;
+}
+
+// Last resort, e.g. for file systems without copy_file_range or sendfile.
+bool copyWithBuffer(int in, int out, off_t offset, size_t length) {
+    std::vector<char> buffer(std::min<size_t>(length, 1 << 20));
+    while (length > 0) {
+        ssize_t n = pread(in, buffer.data(), std::min(buffer.size(), length), offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        for (ssize_t done = 0; done < n;) {
+            ssize_t w = write(out, buffer.data() + done, static_cast<size_t>(n - done));
+            if (w < 0 && errno == EINTR) continue;
+            if (w <= 0) return false;
+            done += w;
+        }
+        offset += n;
+        length -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Appends [offset, offset + length) of `in` to `out`.
+bool copyRange(int in, int out, off_t offset, size_t length) {
+    while (length > 0) {
+        ssize_t n = copy_file_range(in, &offset, out, nullptr, length, 0);
+        if (n > 0) {
+            length -= static_cast<size_t>(n);
+            continue;
+        }
+        if (n == 0) return false;  // the source ended early
+        if (errno == EINTR) continue;
+        if (!unsupported(errno)) return false;
+
+        while (length > 0) {
+            n = sendfile(out, in, &offset, length);
+            if (n > 0) {
+                length -= static_cast<size_t>(n);
+                continue;
+            }
+            if (n == 0) return false;
+            if (errno == EINTR) continue;
+            if (!unsupported(errno)) return false;
+            return copyWithBuffer(in, out, offset, length);
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+bool saveMessagesAsGrib(const std::string& filename, const GribCollection& collection,
+                        const std::vector<size_t>& globalIndices, GribCopyStats* stats) {
+    TRACE_SCOPE("saveGrib", "export");
+    std::vector<ByteRange> ranges;
+    ranges.reserve(globalIndices.size());
+    for (size_t g : globalIndices) {
+        if (g >= collection.lookupByGlobal.size()) return false;
+        auto [fileIdx, indexInFile] = collection.lookupByGlobal[g];
+        ByteRange r{fileIdx, 0, 0};
+        if (!collection.readers[fileIdx]->messageRange(indexInFile, r.offset, r.length))
+            return false;
+        ranges.push_back(r);
+    }
+    std::sort(ranges.begin(), ranges.end(), [](const ByteRange& a, const ByteRange& b) {
+        return a.fileIdx != b.fileIdx ? a.fileIdx < b.fileIdx : a.offset < b.offset;
+    });
+    ranges.erase(std::unique(ranges.begin(), ranges.end(),
+                             [](const ByteRange& a, const ByteRange& b) {
+                                 return a.fileIdx == b.fileIdx && a.offset == b.offset;
+                             }),
+                 ranges.end());
+    const size_t messages = ranges.size();
+
+    // merge runs of messages that follow each other in the same file
+    std::vector<ByteRange> merged;
+    for (const ByteRange& r : ranges) {
+        if (!merged.empty() && merged.back().fileIdx == r.fileIdx &&
+            merged.back().offset + static_cast<long>(merged.back().length) == r.offset)
+            merged.back().length += r.length;
+        else
+            merged.push_back(r);
+    }
+
+    // truncating one of the inputs would destroy what is being copied
+    struct stat target;
+    if (stat(filename.c_str(), &target) == 0) {
+        for (const std::string& path : collection.filenames) {
+            struct stat source;
+            if (stat(path.c_str(), &source) == 0 && source.st_dev == target.st_dev &&
+                source.st_ino == target.st_ino) {
+                std::fprintf(stderr, "%s is one of the open files\n", filename.c_str());
+                return false;
+            }
+        }
+    }
+
+    int out = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0) {
+        std::fprintf(stderr, "Cannot write %s\n", filename.c_str());
+        return false;
+    }
+    bool ok = true;
+    uint64_t bytes = 0;
+    for (const ByteRange& r : merged) {
+        FilePool::Handle in = collection.readers[r.fileIdx]->file();
+        ok = in && copyRange(in.fd(), out, static_cast<off_t>(r.offset), r.length);
+        if (!ok) {
+            std::fprintf(stderr, "Failed to copy from %s\n",
+                         collection.filenames[r.fileIdx].c_str());
+            break;
+        }
+        bytes += r.length;
+    }
+    ok = close(out) == 0 && ok;
+    if (!ok) std::remove(filename.c_str());
+
+    if (stats) {
+        stats->messages = messages;
+        stats->ranges = merged.size();
+        stats->bytes = bytes;
+    }
+    return ok;
+}
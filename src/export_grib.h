@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "grib_collection.h"
+
+struct GribCopyStats {
+    size_t messages = 0;
+    size_t ranges = 0;  // copies after merging adjacent messages
+    uint64_t bytes = 0;
+};
+
+// Writes the original bytes of the messages (global indices) to a new GRIB
+// file, without decoding or re-encoding. Messages go file by file in offset
+// order; runs of adjacent messages are copied as one range, inside the kernel
+// with copy_file_range (sendfile, then read/write, where that is unsupported).
+bool saveMessagesAsGrib(const std::string& filename, const GribCollection& collection,
+                        const std::vector<size_t>& globalIndices, GribCopyStats* stats = nullptr);
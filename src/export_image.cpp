@@ -1,65 +1,194 @@
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include <stb_image_write.h>
-
 #include "export_image.h"
+#include "field_render.h"
+#include "memory_tracker.h"
+#include "task_scheduler.h"
+#include "trace.h"
 
 #include <algorithm>
 #include <cmath>
 #include <cstdio>
+#include <cstring>
+#include <memory>
 
-static std::vector<unsigned char> colorToPixels(int width, int height,
-                                                 const std::vector<Color>& imgData,
-                                                 bool flipVertically)
+static inline unsigned char toByte(float v)
 {
-    std::vector<unsigned char> pixels(width * height * 3);
+    return static_cast<unsigned char>(std::clamp(v, 0.f, 1.f) * 255.f + 0.5f);
+}
+
+static void colorRowToRgb8(const Color* src, int width, unsigned char* dst)
+{
+    for (int x = 0; x < width; ++x) {
+        dst[x * 3 + 0] = toByte(src[x].r);
+        dst[x * 3 + 1] = toByte(src[x].g);
+        dst[x * 3 + 2] = toByte(src[x].b);
+    }
+}
+
+void colorsToRgb8(int width, int height, const std::vector<Color>& imgData,
+                  bool flipVertically, std::vector<unsigned char>& pixels)
+{
+    pixels.resize(static_cast<size_t>(width) * height * 3);
     for (int y = 0; y < height; ++y) {
         int srcY = flipVertically ? (height - 1 - y) : y;
-        for (int x = 0; x < width; ++x) {
-            size_t dst = (y * width + x) * 3;
-            size_t src = srcY * width + x;
-            pixels[dst + 0] = static_cast<unsigned char>(std::clamp(imgData[src].r, 0.f, 1.f) * 255.f + 0.5f);
-            pixels[dst + 1] = static_cast<unsigned char>(std::clamp(imgData[src].g, 0.f, 1.f) * 255.f + 0.5f);
-            pixels[dst + 2] = static_cast<unsigned char>(std::clamp(imgData[src].b, 0.f, 1.f) * 255.f + 0.5f);
-        }
+        colorRowToRgb8(imgData.data() + static_cast<size_t>(srcY) * width, width,
+                       pixels.data() + static_cast<size_t>(y) * width * 3);
     }
-    return pixels;
+}
+
+// Converts each row as the encoder asks for it, on the encoder's threads.
+static PngEncoder::RowSource colorRows(int width, int height,
+                                       const std::vector<Color>& imgData,
+                                       bool flipVertically)
+{
+    return [&imgData, width, height, flipVertically](int y, unsigned char* out) {
+        int srcY = flipVertically ? (height - 1 - y) : y;
+        colorRowToRgb8(imgData.data() + static_cast<size_t>(srcY) * width, width, out);
+    };
 }
 
 bool exportImagePng(const std::string& filename,
                     int width, int height,
                     const std::vector<Color>& imgData,
-                    bool flipVertically)
+                    bool flipVertically, PngLevel level)
+{
+    TRACE_SCOPE("exportPng", "export");
+    if (imgData.size() != static_cast<size_t>(width) * height)
+        return false;
+
+    return writePng(filename, width, height, PngColorType::Rgb,
+                    colorRows(width, height, imgData, flipVertically), level);
+}
+
+void colormapPalette(const GribViewerSettings& settings, std::vector<unsigned char>& rgb)
 {
-    if (imgData.size() != static_cast<size_t>(width * height))
+    std::vector<Color> bar(paletteValueColors + 1);
+    colorizeColorbar(paletteValueColors, 1, settings, bar);
+    bar[missingIndex] = settings.missingColor;
+    colorsToRgb8(paletteValueColors + 1, 1, bar, false, rgb);
+}
+
+bool exportImagePngIndexed(const std::string& filename,
+                           int width, int height,
+                           const std::vector<unsigned char>& indices,
+                           const std::vector<unsigned char>& palette,
+                           bool flipVertically, PngLevel level)
+{
+    TRACE_SCOPE("exportPng", "export");
+    if (indices.size() != static_cast<size_t>(width) * height)
         return false;
 
-    auto pixels = colorToPixels(width, height, imgData, flipVertically);
-    int stride = width * 3;
-    return stbi_write_png(filename.c_str(), width, height, 3, pixels.data(), stride) != 0;
+    return writePng(filename, width, height, PngColorType::Palette,
+                    [&indices, width, height, flipVertically](int y, unsigned char* out) {
+                        int srcY = flipVertically ? (height - 1 - y) : y;
+                        std::memcpy(out, indices.data() + static_cast<size_t>(srcY) * width, width);
+                    }, level, palette);
 }
 
-static void pngWriteToBuffer(void* context, void* data, int size)
+namespace {
+
+struct Band {
+    int y0 = 0;
+    int rows = 0;
+    std::vector<unsigned char> pixels;
+    std::vector<Color> colors;  // RGB exports: the band before conversion
+};
+
+// Bands already colour with every thread, so more in flight only costs memory.
+constexpr int maxBandsAhead = 3;
+
+} // namespace
+
+bool exportFieldPngBanded(const std::string& filename, const GribField& field,
+                          int width, int height, const GribViewerSettings& settings,
+                          const BandedExportOptions& options)
 {
-    auto* buf = static_cast<std::vector<unsigned char>*>(context);
-    auto* bytes = static_cast<unsigned char*>(data);
-    buf->insert(buf->end(), bytes, bytes + size);
+    TRACE_SCOPE("exportPngBanded", "export");
+    if (width <= 0 || height <= 0 || field.values.empty())
+        return false;
+
+    const bool indexed = options.palette;
+    const size_t rowBytes = static_cast<size_t>(width) * (indexed ? 1 : 3);
+    const size_t colorRowBytes = indexed ? 0 : static_cast<size_t>(width) * sizeof(Color);
+    int bandRows = options.bandRows > 0
+        ? options.bandRows
+        : static_cast<int>(std::max<size_t>(1, (size_t(8) << 20) / (rowBytes + colorRowBytes)));
+    bandRows = std::min(bandRows, height);
+    const int bandCount = (height + bandRows - 1) / bandRows;
+    TaskScheduler& scheduler = TaskScheduler::instance();
+    int ahead = options.bandsAhead > 0
+        ? options.bandsAhead
+        : std::min(maxBandsAhead, static_cast<int>(scheduler.concurrency()));
+    ahead = std::clamp(ahead, 1, bandCount);
+
+    std::vector<std::unique_ptr<Band>> bands(ahead);
+    for (auto& b : bands) b = std::make_unique<Band>();
+    MemoryCharge memory{MemCategory::ImageBuffers};
+    memory.set((rowBytes + colorRowBytes) * bandRows * ahead);
+
+    std::vector<unsigned char> palette;
+    if (indexed) colormapPalette(settings, palette);
+    // rows are stored south-up when j scans positively; the image is north-up
+    const bool flip = field.jScansPositively;
+
+    auto produce = [&](int k, int slot) {
+        TRACE_SCOPE("renderBand", "export");
+        Band& band = *bands[slot];
+        band.y0 = k * bandRows;
+        band.rows = std::min(bandRows, height - band.y0);
+        // a flipped band is still one contiguous range of field rows
+        const int first = flip ? height - band.y0 - band.rows : band.y0;
+        band.pixels.resize(rowBytes * band.rows);
+        if (indexed)
+            return colorizeFieldIndexedRows(field, width, height, first, band.rows, settings,
+                                            band.pixels.data()) == ColorizeStatus::Ok;
+        band.colors.resize(static_cast<size_t>(width) * band.rows);
+        if (colorizeFieldRows(field, width, height, first, band.rows, settings,
+                              band.colors.data()) != ColorizeStatus::Ok)
+            return false;
+        parallelFor(0, band.rows, [&](long r) {
+            colorRowToRgb8(band.colors.data() + static_cast<size_t>(width) * r,
+                           width, band.pixels.data() + rowBytes * r);
+        });
+        return true;
+    };
+
+    FILE* f = std::fopen(filename.c_str(), "wb");
+    if (!f)
+        return false;
+    PngEncoder png([f](const unsigned char* data, size_t size) {
+        return std::fwrite(data, 1, size, f) == size;
+    }, width, height, indexed ? PngColorType::Palette : PngColorType::Rgb, options.level);
+    png.setPalette(palette);
+
+    auto consume = [&](int, int slot, bool produced) {
+        const Band& band = *bands[slot];
+        return produced &&
+               png.writeRows(band.rows, [&band, rowBytes, flip](int y, unsigned char* out) {
+                   const int r = flip ? band.y0 + band.rows - 1 - y : y - band.y0;
+                   std::memcpy(out, band.pixels.data() + rowBytes * r, rowBytes);
+               });
+    };
+    bool ok = orderedPipeline(bandCount, ahead, TaskPriority::Prefetch, produce, consume);
+
+    ok = ok && png.finish();
+    ok = std::fclose(f) == 0 && ok;
+    if (!ok) std::remove(filename.c_str());
+    return ok;
 }
 
 bool copyImageToClipboard(int width, int height,
                           const std::vector<Color>& imgData,
                           bool flipVertically)
 {
-    if (imgData.size() != static_cast<size_t>(width * height))
+    TRACE_SCOPE("copyImage", "export");
+    if (imgData.size() != static_cast<size_t>(width) * height)
         return false;
 
-    auto pixels = colorToPixels(width, height, imgData, flipVertically);
-
-    // Encode PNG to memory buffer
+    // Encode PNG to memory buffer; speed matters more than size here
     std::vector<unsigned char> pngBuf;
-    int stride = width * 3;
-    int ok = stbi_write_png_to_func(pngWriteToBuffer, &pngBuf,
-                                     width, height, 3, pixels.data(), stride);
-    if (!ok || pngBuf.empty())
+    if (!writePng(pngBuf, width, height, PngColorType::Rgb,
+                  colorRows(width, height, imgData, flipVertically), PngLevel::Fast) ||
+        pngBuf.empty())
         return false;
 
     // Pipe PNG data to xclip
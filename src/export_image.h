@@ -3,11 +3,46 @@
 #include <string>
 #include <vector>
 #include "gradient.h"
+#include "grib_reader.h"
+#include "png_encoder.h"
+#include "settings.h"
+
+// 8-bit RGB, rows optionally flipped so the image is north-up.
+void colorsToRgb8(int width, int height, const std::vector<Color>& imgData,
+                  bool flipVertically, std::vector<unsigned char>& pixels);
 
 bool exportImagePng(const std::string& filename,
                     int width, int height,
                     const std::vector<Color>& imgData,
-                    bool flipVertically = false);
+                    bool flipVertically = false,
+                    PngLevel level = PngLevel::Default);
+
+// The 256 colours colorizeFieldIndexed indexes into, as RGB triplets: the
+// colour scale, then the missing-value colour.
+void colormapPalette(const GribViewerSettings& settings, std::vector<unsigned char>& rgb);
+
+// Palette PNG from colorizeFieldIndexed output: one byte per pixel instead
+// of three and no RGB conversion.
+bool exportImagePngIndexed(const std::string& filename,
+                           int width, int height,
+                           const std::vector<unsigned char>& indices,
+                           const std::vector<unsigned char>& palette,
+                           bool flipVertically = false,
+                           PngLevel level = PngLevel::Default);
+
+struct BandedExportOptions {
+    int bandRows = 0;    // rows per band; 0 picks about 8 MiB of buffers per band
+    int bandsAhead = 0;  // bands rendered ahead of the encoder; 0: up to 3
+    bool palette = false;
+    PngLevel level = PngLevel::Default;
+};
+
+// Renders the field at any output size in horizontal bands and streams each
+// band into the PNG encoder while the next ones are being coloured, so
+// memory is bounded by the band size, not the image (posters, 4x upscales).
+bool exportFieldPngBanded(const std::string& filename, const GribField& field,
+                          int width, int height, const GribViewerSettings& settings,
+                          const BandedExportOptions& options = {});
 
 bool copyImageToClipboard(int width, int height,
                           const std::vector<Color>& imgData,
@@ -0,0 +1,239 @@
+#include "export_values.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
+
+#include "task_scheduler.h"
+#include "trace.h"
+
+namespace {
+
+bool littleEndian() {
+    const uint16_t probe = 1;
+    unsigned char first;
+    std::memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+void appendJsonString(std::string& out, const std::string& s) {
+    out += '"';
+    for (unsigned char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += static_cast<char>(c);
+        } else if (c < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else {
+            out += static_cast<char>(c);
+        }
+    }
+    out += '"';
+}
+
+void appendKey(std::string& out, const char* key) {
+    if (out.size() > 1) out += ", ";
+    appendJsonString(out, key);
+    out += ": ";
+}
+
+void appendField(std::string& out, const char* key, const std::string& value) {
+    appendKey(out, key);
+    appendJsonString(out, value);
+}
+
+void appendField(std::string& out, const char* key, long value) {
+    appendKey(out, key);
+    out += std::to_string(value);
+}
+
+void appendField(std::string& out, const char* key, double value) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.17g", value);
+    appendKey(out, key);
+    out += buf;
+}
+
+// Everything a reader needs to interpret the array without ecCodes.
+std::string metadataJson(const GribField& field, const GribMessageInfo* info, ValuesType type,
+                         long dataOffset) {
+    std::string j = "{";
+    appendField(j, "dtype", std::string(type == ValuesType::Float32 ? "float32" : "float64"));
+    appendField(j, "byte_order", std::string(littleEndian() ? "little" : "big"));
+    appendKey(j, "shape");
+    j += "[" + std::to_string(field.height) + ", " + std::to_string(field.width) + "]";
+    appendKey(j, "j_scans_positively");
+    j += field.jScansPositively ? "true" : "false";
+    if (dataOffset >= 0) appendField(j, "data_offset", dataOffset);
+    appendField(j, "name", field.name);
+    appendField(j, "shortName", field.shortName);
+    appendField(j, "units", field.units);
+    appendField(j, "typeOfLevel", field.typeOfLevel);
+    appendField(j, "level", field.level);
+    appendField(j, "discipline", field.discipline);
+    appendField(j, "parameterCategory", field.parameterCategory);
+    appendField(j, "parameterNumber", field.parameterNumber);
+    appendField(j, "indicatorOfParameter", field.indicatorOfParameter);
+    appendField(j, "perturbationNumber", field.perturbationNumber);
+    appendField(j, "min", field.min_value);
+    appendField(j, "max", field.max_value);
+    // missing points are NaN in the array
+    appendField(j, "missing", static_cast<long>(field.missingCount));
+    if (info) {
+        appendField(j, "step", info->step);
+        appendField(j, "stepUnits", info->stepUnits);
+        appendField(j, "dataDate", info->dataDate);
+        appendField(j, "dataTime", info->dataTime);
+        appendField(j, "validityDate", info->validityDate);
+        appendField(j, "validityTime", info->validityTime);
+    }
+    j += "}";
+    return j;
+}
+
+// Pads `header` with spaces and a newline to a multiple of 64 bytes from
+// `prefix` bytes in, so the data that follows is aligned.
+void padHeader(std::string& header, size_t prefix) {
+    const size_t total = (prefix + header.size() + 1 + 63) / 64 * 64;
+    header.append(total - prefix - header.size() - 1, ' ');
+    header += '\n';
+}
+
+std::string npyHeader(const GribField& field, ValuesType type) {
+    std::string dict = "{'descr': '";
+    dict += littleEndian() ? '<' : '>';
+    dict += type == ValuesType::Float32 ? "f4" : "f8";
+    dict += "', 'fortran_order': False, 'shape': (" + std::to_string(field.height) + ", " +
+            std::to_string(field.width) + "), }";
+    padHeader(dict, 10);
+    std::string header("\x93NUMPY\x01\x00", 8);
+    header += static_cast<char>(dict.size() & 0xFF);
+    header += static_cast<char>(dict.size() >> 8);
+    return header + dict;
+}
+
+std::string rawHeader(const GribField& field, const GribMessageInfo* info, ValuesType type) {
+    // the offset is part of the header it points past; settle it by iterating
+    long offset = 0;
+    std::string header;
+    for (;;) {
+        header = metadataJson(field, info, type, offset);
+        padHeader(header, 0);
+        if (static_cast<long>(header.size()) == offset) return header;
+        offset = static_cast<long>(header.size());
+    }
+}
+
+bool writeAll(int fd, iovec* iov, int count) {
+    while (count > 0) {
+        ssize_t n = writev(fd, iov, std::min(count, IOV_MAX));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        // skip what was written; writev may stop anywhere
+        while (count > 0 && static_cast<size_t>(n) >= iov->iov_len) {
+            n -= static_cast<ssize_t>(iov->iov_len);
+            ++iov;
+            --count;
+        }
+        if (count > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + n;
+            iov->iov_len -= static_cast<size_t>(n);
+        }
+    }
+    return true;
+}
+
+bool writeFloat64(int fd, const std::string& header, const FieldValues& values) {
+    iovec iov[2];
+    iov[0].iov_base = const_cast<char*>(header.data());
+    iov[0].iov_len = header.size();
+    iov[1].iov_base = const_cast<double*>(values.data());
+    iov[1].iov_len = values.size() * sizeof(double);
+    return writeAll(fd, iov, 2);
+}
+
+bool pwriteAll(int fd, const void* data, size_t size, off_t offset) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t n = pwrite(fd, p, size, offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += n;
+        size -= static_cast<size_t>(n);
+        offset += n;
+    }
+    return true;
+}
+
+// Each chunk is converted into its own buffer and written at its offset, so
+// a full disk fails a write instead of faulting on a mapped page.
+bool writeFloat32(int fd, const std::string& header, const FieldValues& values) {
+    if (!pwriteAll(fd, header.data(), header.size(), 0)) return false;
+    const long chunk = 1 << 16;
+    const long n = static_cast<long>(values.size());
+    std::atomic<bool> ok{true};
+    parallelFor(0, (n + chunk - 1) / chunk, [&](long c) {
+        if (!ok.load(std::memory_order_relaxed)) return;
+        const long begin = c * chunk;
+        const long end = std::min(n, begin + chunk);
+        std::vector<float> data(static_cast<size_t>(end - begin));
+        for (long i = begin; i < end; ++i) data[i - begin] = static_cast<float>(values[i]);
+        const off_t offset = static_cast<off_t>(header.size() + begin * sizeof(float));
+        if (!pwriteAll(fd, data.data(), data.size() * sizeof(float), offset))
+            ok = false;
+    }, TaskScheduler::currentPriority(), 1);
+    return ok.load();
+}
+
+} // namespace
+
+bool valuesFormatFromName(const std::string& filename, ValuesFormat& format) {
+    std::string ext = filename.substr(filename.find_last_of('.') + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    if (ext == "npy") format = ValuesFormat::Npy;
+    else if (ext == "bin" || ext == "raw") format = ValuesFormat::Raw;
+    else return false;
+    return true;
+}
+
+bool exportFieldValues(const std::string& filename, const GribField& field,
+                       const GribMessageInfo* info, ValuesFormat format, ValuesType type) {
+    TRACE_SCOPE("exportValues", "export");
+    if (field.values.empty() ||
+        field.values.size() != static_cast<size_t>(field.width) * field.height)
+        return false;
+
+    const std::string header = format == ValuesFormat::Npy ? npyHeader(field, type)
+                                                           : rawHeader(field, info, type);
+    int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+    bool ok = type == ValuesType::Float64 ? writeFloat64(fd, header, field.values)
+                                          : writeFloat32(fd, header, field.values);
+    ok = close(fd) == 0 && ok;
+
+    if (ok && format == ValuesFormat::Npy) {
+        const size_t dot = filename.find_last_of('.');
+        const std::string sidecar = filename.substr(0, dot) + ".json";
+        FILE* f = std::fopen(sidecar.c_str(), "w");
+        const std::string json = metadataJson(field, info, type, -1) + "\n";
+        ok = f && std::fwrite(json.data(), 1, json.size(), f) == json.size();
+        if (f) ok = std::fclose(f) == 0 && ok;
+    }
+    if (!ok) std::remove(filename.c_str());
+    return ok;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+
+#include "grib_reader.h"
+
+enum class ValuesFormat {
+    Npy,  // NumPy array of shape (height, width), metadata in a .json next to it
+    Raw   // one JSON header line padded to 64 bytes, then the values
+};
+
+enum class ValuesType {
+    Float64,  // as decoded
+    Float32
+};
+
+// Picks the format from the extension (.npy, .bin or .raw); false if unknown.
+bool valuesFormatFromName(const std::string& filename, ValuesFormat& format);
+
+// Writes field.values in message order (rows as scanned; see
+// "j_scans_positively" in the metadata) in native byte order, with NaN for
+// missing values. Float64 is
+// written with writev straight from field.values; Float32 is converted in
+// parallel chunks, each written with pwrite. `info` adds step and dates.
+bool exportFieldValues(const std::string& filename, const GribField& field,
+                       const GribMessageInfo* info, ValuesFormat format,
+                       ValuesType type = ValuesType::Float64);
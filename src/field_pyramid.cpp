@@ -0,0 +1,194 @@
+#include "field_pyramid.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+#include "task_scheduler.h"
+#include "trace.h"
+#include "value_mask.h"
+
+// One 2x2 reduction step. `weight(sx, sy, idx)` is the number of
+// full-resolution values under a source cell: fewer at the edges of odd-sized
+// sources, none where everything is missing. Means are weighted by it.
+template <typename T, typename Weight>
+static void reduceLevel(const T* srcMean, const T* srcMin, const T* srcMax,
+                        long srcWidth, long srcHeight, Weight weight, bool keepCounts,
+                        PyramidLevel& dst) {
+    dst.width = (srcWidth + 1) / 2;
+    dst.height = (srcHeight + 1) / 2;
+    const size_t n = static_cast<size_t>(dst.width) * dst.height;
+    dst.mean.resize(n);
+    dst.min.resize(n);
+    dst.max.resize(n);
+    dst.count.resize(keepCounts ? n : 0);
+
+    std::atomic<bool> anyMissing{false};
+    parallelFor(0, dst.height, [&](long y) {
+        const long sy0 = 2 * y;
+        const long sy1 = std::min(sy0 + 2, srcHeight);
+        bool rowMissing = false;
+        for (long x = 0; x < dst.width; ++x) {
+            const long sx0 = 2 * x;
+            const long sx1 = std::min(sx0 + 2, srcWidth);
+            double sum = 0.0;
+            float lo = std::numeric_limits<float>::infinity();
+            float hi = -std::numeric_limits<float>::infinity();
+            uint64_t count = 0;
+            for (long sy = sy0; sy < sy1; ++sy) {
+                for (long sx = sx0; sx < sx1; ++sx) {
+                    const long idx = sy * srcWidth + sx;
+                    const uint64_t w = weight(sx, sy, idx);
+                    if (w == 0) continue;
+                    sum += static_cast<double>(srcMean[idx]) * static_cast<double>(w);
+                    lo = std::min(lo, static_cast<float>(srcMin[idx]));
+                    hi = std::max(hi, static_cast<float>(srcMax[idx]));
+                    count += w;
+                }
+            }
+            const size_t out = static_cast<size_t>(y) * dst.width + x;
+            if (count == 0) {
+                rowMissing = true;
+                lo = hi = std::numeric_limits<float>::quiet_NaN();
+            }
+            dst.mean[out] = count > 0 ? static_cast<float>(sum / static_cast<double>(count)) : lo;
+            dst.min[out] = lo;
+            dst.max[out] = hi;
+            if (keepCounts) dst.count[out] = static_cast<uint32_t>(count);
+        }
+        if (rowMissing) anyMissing.store(true, std::memory_order_relaxed);
+    });
+    dst.hasMissing = anyMissing.load();
+}
+
+void FieldPyramid::build(const FieldValues& values, const uint64_t* mask, long width,
+                         long height) {
+    TRACE_SCOPE("buildPyramid", "index");
+    if ((width <= 1 && height <= 1) || values.size() != static_cast<size_t>(width * height)) {
+        clear();
+        return;
+    }
+    baseWidth = width;
+    baseHeight = height;
+
+    // the previous field's levels are overwritten in place
+    size_t used = 0;
+    auto nextLevel = [&]() -> PyramidLevel& {
+        if (used == levels.size()) levels.emplace_back();
+        return levels[used++];
+    };
+    // without a mask every cell covers its whole block, so counts need no storage
+    const bool keepCounts = mask != nullptr;
+    PyramidLevel& first = nextLevel();
+    if (mask)
+        reduceLevel(values.data(), values.data(), values.data(), width, height,
+                    [mask](long, long, long idx) -> uint64_t {
+                        return maskBit(mask, static_cast<size_t>(idx));
+                    }, true, first);
+    else
+        reduceLevel(values.data(), values.data(), values.data(), width, height,
+                    [](long, long, long) -> uint64_t { return 1; }, false, first);
+    while (levels[used - 1].width > 1 || levels[used - 1].height > 1) {
+        PyramidLevel& next = nextLevel();
+        const PyramidLevel& prev = levels[used - 2];
+        const int k = static_cast<int>(used) - 1;
+        reduceLevel(prev.mean.data(), prev.min.data(), prev.max.data(), prev.width,
+                    prev.height, [this, k](long x, long y, long) { return cellCount(k, x, y); },
+                    keepCounts, next);
+    }
+    levels.resize(used);
+
+    size_t bytes = 0;
+    for (const PyramidLevel& l : levels)
+        bytes += (l.mean.capacity() + l.min.capacity() + l.max.capacity()) * sizeof(float) +
+                 l.count.capacity() * sizeof(uint32_t);
+    memory.set(bytes);
+}
+
+int FieldPyramid::levelCountFor(long width, long height) {
+    int count = 0;
+    while (width > 1 || height > 1) {
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+        ++count;
+    }
+    return count;
+}
+
+uint64_t FieldPyramid::cellCount(int k, long x, long y) const {
+    const PyramidLevel& lvl = levels[k - 1];
+    if (!lvl.count.empty()) return lvl.count[static_cast<size_t>(y) * lvl.width + x];
+    const long w = std::min((x + 1) << k, baseWidth) - (x << k);
+    const long h = std::min((y + 1) << k, baseHeight) - (y << k);
+    return static_cast<uint64_t>(w) * static_cast<uint64_t>(h);
+}
+
+struct FieldPyramid::RegionAccum {
+    double lo = std::numeric_limits<double>::infinity();
+    double hi = -std::numeric_limits<double>::infinity();
+    double sum = 0.0;
+    uint64_t count = 0;
+};
+
+void FieldPyramid::accumulate(int k, long x0, long y0, long x1, long y1, const double* values,
+                              const uint64_t* mask, RegionAccum& acc) const {
+    if (k == 0) {
+        for (long y = y0; y < y1; ++y) {
+            for (long x = x0; x < x1; ++x) {
+                const size_t idx = static_cast<size_t>(y) * baseWidth + x;
+                if (mask && !maskBit(mask, idx)) continue;
+                acc.lo = std::min(acc.lo, values[idx]);
+                acc.hi = std::max(acc.hi, values[idx]);
+                acc.sum += values[idx];
+                ++acc.count;
+            }
+        }
+        return;
+    }
+    const PyramidLevel& lvl = levels[k - 1];
+    for (long cy = y0 >> k; cy <= (y1 - 1) >> k; ++cy) {
+        const long cy0 = cy << k;
+        const long cy1 = std::min((cy + 1) << k, baseHeight);
+        for (long cx = x0 >> k; cx <= (x1 - 1) >> k; ++cx) {
+            const long cx0 = cx << k;
+            const long cx1 = std::min((cx + 1) << k, baseWidth);
+            if (cx0 < x0 || cx1 > x1 || cy0 < y0 || cy1 > y1) {
+                // crosses the edge: only the part inside, one level finer
+                accumulate(k - 1, std::max(cx0, x0), std::max(cy0, y0), std::min(cx1, x1),
+                           std::min(cy1, y1), values, mask, acc);
+                continue;
+            }
+            const uint64_t n = cellCount(k, cx, cy);
+            if (n == 0) continue;
+            const size_t idx = static_cast<size_t>(cy) * lvl.width + cx;
+            acc.lo = std::min(acc.lo, static_cast<double>(lvl.min[idx]));
+            acc.hi = std::max(acc.hi, static_cast<double>(lvl.max[idx]));
+            acc.sum += static_cast<double>(lvl.mean[idx]) * static_cast<double>(n);
+            acc.count += n;
+        }
+    }
+}
+
+bool FieldPyramid::regionStats(const FieldValues& values, const uint64_t* mask,
+                               long x0, long y0, long x1, long y1, int maxLevel,
+                               double& minOut, double& maxOut, double& meanOut) const {
+    x0 = std::max(x0, 0L);
+    y0 = std::max(y0, 0L);
+    x1 = std::min(x1, baseWidth);
+    y1 = std::min(y1, baseHeight);
+    if (x0 >= x1 || y0 >= y1 ||
+        values.size() != static_cast<size_t>(baseWidth) * static_cast<size_t>(baseHeight))
+        return false;
+    // coarsest level that still resolves the rectangle's shortest side
+    int k = std::min(maxLevel, levelCount());
+    while (k > 0 && (std::min(x1 - x0, y1 - y0) >> k) < 1) --k;
+
+    RegionAccum acc;
+    accumulate(k, x0, y0, x1, y1, values.data(), mask, acc);
+    if (acc.count == 0) return false;
+    minOut = acc.lo;
+    maxOut = acc.hi;
+    meanOut = acc.sum / static_cast<double>(acc.count);
+    return true;
+}
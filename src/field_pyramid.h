@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "memory_tracker.h"
+#include "value_pool.h"
+
+// Which 2x2 aggregate a zoomed-out view shows.
+enum class PyramidStat {
+    Mean,
+    Min,
+    Max
+};
+
+struct PyramidLevel {
+    long width = 0;
+    long height = 0;
+    // cells over missing values only hold NaN in all three statistics
+    bool hasMissing = false;
+    std::vector<float> mean;
+    std::vector<float> min;
+    std::vector<float> max;
+    // full-resolution values present under each cell; only kept for fields
+    // with missing values, the others cover whole (or edge-clipped) blocks
+    std::vector<uint32_t> count;
+
+    const std::vector<float>& stat(PyramidStat s) const {
+        switch (s) {
+            case PyramidStat::Min: return min;
+            case PyramidStat::Max: return max;
+            case PyramidStat::Mean: break;
+        }
+        return mean;
+    }
+};
+
+// Multi-resolution reduction of a decoded field. Level k (1-based) halves the
+// resolution k times; every level keeps mean, min and max of the full-resolution
+// values it covers, so extremes such as precipitation cores survive zooming out.
+class FieldPyramid {
+public:
+    // Missing values (mask bit clear, see value_mask.h) are left out of
+    // every statistic. Reuses the storage of the levels built before.
+    void build(const FieldValues& values, const uint64_t* mask, long width, long height);
+    void clear() {
+        levels.clear();
+        baseWidth = 0;
+        baseHeight = 0;
+        memory.set(0);
+    }
+
+    int levelCount() const { return static_cast<int>(levels.size()); }
+    // levels build() makes for a field of this size
+    static int levelCountFor(long width, long height);
+    // level(0) is not stored: the field itself is the base of the pyramid.
+    const PyramidLevel* level(int k) const {
+        if (k < 1 || k > levelCount()) return nullptr;
+        return &levels[k - 1];
+    }
+
+    // Full-resolution values present under cell (x, y) of level k.
+    uint64_t cellCount(int k, long x, long y) const;
+
+    // Min/max/mean of the values in the full-resolution rectangle
+    // [x0, x1) x [y0, y1) of the field the pyramid was built from. Cells
+    // inside it are read from the coarsest level up to `maxLevel` that still
+    // resolves the rectangle; cells crossing its edge are split into finer
+    // levels, down to the values themselves. The mean is weighted by the
+    // values under each cell. False if the rectangle holds no value.
+    bool regionStats(const FieldValues& values, const uint64_t* mask,
+                     long x0, long y0, long x1, long y1, int maxLevel,
+                     double& minOut, double& maxOut, double& meanOut) const;
+
+private:
+    struct RegionAccum;
+    void accumulate(int k, long x0, long y0, long x1, long y1, const double* values,
+                    const uint64_t* mask, RegionAccum& acc) const;
+
+    std::vector<PyramidLevel> levels;
+    long baseWidth = 0;
+    long baseHeight = 0;
+    MemoryCharge memory{MemCategory::Pyramid};
+};
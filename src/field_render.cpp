@@ -0,0 +1,227 @@
+#include "field_render.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "color_adjust.h"
+#include "task_scheduler.h"
+#include "trace.h"
+#include "value_mask.h"
+
+bool colorRange(const GribField& field, const GribViewerSettings& settings,
+    float& colorMinValue, float& colorMaxValue) {
+    if (settings.useCustomMinMax || settings.symmetricAroundZero) {
+        if (settings.minVal >= settings.maxVal)
+            return false;
+        colorMinValue = settings.minVal;
+        colorMaxValue = settings.maxVal;
+    }
+    else {
+        colorMinValue = static_cast<float>(field.min_value);
+        colorMaxValue = static_cast<float>(field.max_value);
+    }
+    return true;
+}
+
+// Rows without gaps, checked a word at a time, take the unmasked loop.
+static bool rowGaps(const uint64_t* mask, size_t rowStart, long width) {
+    return mask && !maskRangeFull(mask, rowStart, static_cast<size_t>(width));
+}
+
+Color valueToColor(double value, double min_val, double max_val, const Gradient& gradient,
+    const GribViewerSettings& settings) {
+    // Normalize value to 0-1
+    double normalized = (value - min_val) / (max_val - min_val);
+    normalized = std::clamp(normalized, 0.0, 1.0);
+    if (settings.discreteColors) {
+        normalized = std::floor(normalized * settings.colorCount) / (settings.colorCount - 1.);
+    }
+    if (settings.sqrtScale) normalized = sqrt(normalized);
+    
+    // Color c = value >= -999999999. ? Color(.7f, 0.f, 0.f) : gradient.get_color(static_cast<float>(normalized));
+    Color c = gradient.get_color(static_cast<float>(normalized), settings.oldColorBug);
+    return applyHclAdjustments(c, settings.brightness, settings.gamma,
+                               settings.vibrancy, settings.hueShift);
+}
+
+ColorizeStatus colorizeField(const GribField& field, int displayWidth, int displayHeight,
+    const GribViewerSettings& settings, std::vector<Color>& imgData) {
+    TRACE_SCOPE("renderField", "render");
+    return colorizeFieldRows(field, displayWidth, displayHeight, 0, displayHeight, settings,
+        imgData.data());
+}
+
+ColorizeStatus colorizeFieldRows(const GribField& field, int displayWidth, int displayHeight,
+    int firstRow, int rowCount, const GribViewerSettings& settings, Color* imgData) {
+    if (field.values.empty() || field.width == 0 || field.height == 0)
+        return ColorizeStatus::NoData;
+    
+    float colorMinValue = 0.f;
+    float colorMaxValue = 0.f;
+    if (!colorRange(field, settings, colorMinValue, colorMaxValue))
+        return ColorizeStatus::InvalidRange;
+
+    const Gradient& gradient = GradientRegistry::instance().gradient(settings.gradient);
+    const uint64_t* mask = field.mask();
+    // Fill each pixel; 64-bit positions, as upscaled exports exceed 2^31 pixels
+    parallelFor(0, rowCount, [&](long r) {
+        const long fieldPosY = (firstRow + r) * field.height / displayHeight;
+        const size_t rowStart = static_cast<size_t>(field.width) * fieldPosY;
+        const double* row = field.values.data() + rowStart;
+        Color* out = imgData + static_cast<size_t>(r) * displayWidth;
+        const uint64_t* rowMask = rowGaps(mask, rowStart, field.width) ? mask : nullptr;
+        for (int x = 0; x < displayWidth; ++x) {
+            const long fieldPosX = static_cast<long>(x) * field.width / displayWidth;
+            if (rowMask && !maskBit(rowMask, rowStart + fieldPosX))
+                out[x] = settings.missingColor;
+            else
+                out[x] = valueToColor(row[fieldPosX], colorMinValue, colorMaxValue, gradient,
+                    settings);
+        }
+    });
+    return ColorizeStatus::Ok;
+}
+
+ColorizeStatus colorizeFieldIndexed(const GribField& field, int displayWidth, int displayHeight,
+    const GribViewerSettings& settings, std::vector<unsigned char>& indices) {
+    TRACE_SCOPE("renderFieldIndexed", "render");
+    indices.resize(static_cast<size_t>(displayWidth) * displayHeight);
+    return colorizeFieldIndexedRows(field, displayWidth, displayHeight, 0, displayHeight,
+        settings, indices.data());
+}
+
+ColorizeStatus colorizeFieldIndexedRows(const GribField& field, int displayWidth,
+    int displayHeight, int firstRow, int rowCount, const GribViewerSettings& settings,
+    unsigned char* indices) {
+    if (field.values.empty() || field.width == 0 || field.height == 0)
+        return ColorizeStatus::NoData;
+
+    float colorMinValue = 0.f;
+    float colorMaxValue = 0.f;
+    if (!colorRange(field, settings, colorMinValue, colorMaxValue))
+        return ColorizeStatus::InvalidRange;
+
+    // the colorbar applies discrete steps and the sqrt scale to its x
+    const double top = paletteValueColors - 1;
+    const double scale = top / (static_cast<double>(colorMaxValue) - colorMinValue);
+    const uint64_t* mask = field.mask();
+    parallelFor(0, rowCount, [&](long r) {
+        const long fieldPosY = (firstRow + r) * field.height / displayHeight;
+        const size_t rowStart = static_cast<size_t>(field.width) * fieldPosY;
+        const double* row = field.values.data() + rowStart;
+        unsigned char* out = indices + static_cast<size_t>(r) * displayWidth;
+        const uint64_t* rowMask = rowGaps(mask, rowStart, field.width) ? mask : nullptr;
+        for (int x = 0; x < displayWidth; ++x) {
+            const long fieldPosX = static_cast<long>(x) * field.width / displayWidth;
+            if (rowMask && !maskBit(rowMask, rowStart + fieldPosX)) {
+                out[x] = missingIndex;
+                continue;
+            }
+            double idx = std::clamp((row[fieldPosX] - colorMinValue) * scale, 0., top);
+            out[x] = static_cast<unsigned char>(std::lround(idx));
+        }
+    });
+    return ColorizeStatus::Ok;
+}
+
+ColorizeStatus colorizeRegion(const GribField& field, int x0, int y0, int w, int h,
+    const GribViewerSettings& settings, Color* imgData) {
+    TRACE_SCOPE("renderRegion", "render");
+    if (field.values.empty() || field.width == 0 || field.height == 0)
+        return ColorizeStatus::NoData;
+
+    float colorMinValue = 0.f;
+    float colorMaxValue = 0.f;
+    if (!colorRange(field, settings, colorMinValue, colorMaxValue))
+        return ColorizeStatus::InvalidRange;
+
+    const Gradient& gradient = GradientRegistry::instance().gradient(settings.gradient);
+    const uint64_t* mask = field.mask();
+    parallelFor(0, h, [&](long y) {
+        const size_t rowStart = static_cast<size_t>(field.width) * (y0 + y) + x0;
+        const double* row = field.values.data() + rowStart;
+        Color* out = imgData + static_cast<size_t>(y) * w;
+        const uint64_t* rowMask = rowGaps(mask, rowStart, w) ? mask : nullptr;
+        for (int x = 0; x < w; ++x) {
+            if (rowMask && !maskBit(rowMask, rowStart + x))
+                out[x] = settings.missingColor;
+            else
+                out[x] = valueToColor(row[x], colorMinValue, colorMaxValue, gradient,
+                    settings);
+        }
+    });
+    return ColorizeStatus::Ok;
+}
+
+ColorizeStatus colorizeLevel(const GribField& field, int level,
+    const GribViewerSettings& settings, std::vector<Color>& imgData) {
+    TRACE_SCOPE("renderLevel", "render");
+    const PyramidLevel* lvl = field.pyramid.level(level);
+    if (!lvl) return ColorizeStatus::NoData;
+
+    float colorMinValue = 0.f;
+    float colorMaxValue = 0.f;
+    if (!colorRange(field, settings, colorMinValue, colorMaxValue))
+        return ColorizeStatus::InvalidRange;
+
+    const Gradient& gradient = GradientRegistry::instance().gradient(settings.gradient);
+    const std::vector<float>& values = lvl->stat(settings.zoomOutStat);
+    imgData.resize(values.size());
+    // a level cell is missing when every value under it is
+    const bool gaps = lvl->hasMissing;
+    parallelFor(0, static_cast<long>(values.size()), [&](long i) {
+        if (gaps && std::isnan(values[i]))
+            imgData[i] = settings.missingColor;
+        else
+            imgData[i] = valueToColor(values[i], colorMinValue, colorMaxValue, gradient,
+                settings);
+    });
+    return ColorizeStatus::Ok;
+}
+
+ColorizeStatus colorizeLevelIndexed(const GribField& field, int level,
+    const GribViewerSettings& settings, std::vector<unsigned char>& indices) {
+    TRACE_SCOPE("renderLevelIndexed", "render");
+    const PyramidLevel* lvl = field.pyramid.level(level);
+    if (!lvl) return ColorizeStatus::NoData;
+
+    float colorMinValue = 0.f;
+    float colorMaxValue = 0.f;
+    if (!colorRange(field, settings, colorMinValue, colorMaxValue))
+        return ColorizeStatus::InvalidRange;
+
+    const double top = paletteValueColors - 1;
+    const double scale = top / (static_cast<double>(colorMaxValue) - colorMinValue);
+    const std::vector<float>& values = lvl->stat(settings.zoomOutStat);
+    indices.resize(values.size());
+    const bool gaps = lvl->hasMissing;
+    parallelFor(0, static_cast<long>(values.size()), [&](long i) {
+        if (gaps && std::isnan(values[i])) {
+            indices[i] = missingIndex;
+            return;
+        }
+        double idx = std::clamp((values[i] - colorMinValue) * scale, 0., top);
+        indices[i] = static_cast<unsigned char>(std::lround(idx));
+    });
+    return ColorizeStatus::Ok;
+}
+
+void colorizeColorbar(int width, int height, const GribViewerSettings& settings,
+    std::vector<Color>& data) {
+    TRACE_SCOPE("renderColorbar", "render");
+    const Gradient& gradient = GradientRegistry::instance().gradient(settings.gradient);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint idx = y * width + x;
+            float cidx = float(x) / float(width - 1);
+            cidx = std::clamp(cidx, 0.f, 1.f);
+            if (settings.discreteColors) {
+                cidx = std::floor(cidx * settings.colorCount) / (settings.colorCount - 1.);
+            }
+            if (settings.sqrtScale) cidx = sqrt(cidx);
+            Color c = gradient.get_color(cidx, settings.oldColorBug);
+            data[idx] = applyHclAdjustments(c, settings.brightness, settings.gamma,
+                                            settings.vibrancy, settings.hueShift);
+        }
+    }
+}
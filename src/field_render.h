@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+
+#include "grib_reader.h"
+#include "settings.h"
+
+// CPU colour path: field values -> colormap -> HCL adjustments. Shared by the
+// GUI Renderer and the headless tools, so it must stay free of GL and ImGui.
+
+enum class ColorizeStatus {
+    Ok,
+    NoData,
+    InvalidRange
+};
+
+// Colour scale limits for a field: the custom/symmetric range from the
+// settings, or the field's own min/max. Returns false for an empty custom range.
+bool colorRange(const GribField& field, const GribViewerSettings& settings,
+    float& colorMinValue, float& colorMaxValue);
+
+Color valueToColor(double value, double min_val, double max_val, const Gradient& gradient,
+    const GribViewerSettings& settings);
+
+// Nearest-neighbour resample of the field to displayWidth x displayHeight.
+// Missing values take settings.missingColor in all of these.
+ColorizeStatus colorizeField(const GribField& field, int displayWidth, int displayHeight,
+    const GribViewerSettings& settings, std::vector<Color>& imgData);
+
+// Rows [firstRow, firstRow + rowCount) of the same resample into a
+// displayWidth x rowCount buffer, for rendering large images in bands.
+ColorizeStatus colorizeFieldRows(const GribField& field, int displayWidth, int displayHeight,
+    int firstRow, int rowCount, const GribViewerSettings& settings, Color* imgData);
+
+// Same sampling as colorizeField, but one byte per pixel, for palette images:
+// values map to the colours of colorizeColorbar(paletteValueColors, 1) and
+// missing values to missingIndex (see colormapPalette).
+constexpr int paletteValueColors = 255;
+constexpr unsigned char missingIndex = 255;
+ColorizeStatus colorizeFieldIndexed(const GribField& field, int displayWidth, int displayHeight,
+    const GribViewerSettings& settings, std::vector<unsigned char>& indices);
+ColorizeStatus colorizeFieldIndexedRows(const GribField& field, int displayWidth,
+    int displayHeight, int firstRow, int rowCount, const GribViewerSettings& settings,
+    unsigned char* indices);
+
+// Field rectangle [x0, x0 + w) x [y0, y0 + h) at full resolution into a w x h buffer.
+ColorizeStatus colorizeRegion(const GribField& field, int x0, int y0, int w, int h,
+    const GribViewerSettings& settings, Color* out);
+
+// Pyramid level `level` (see FieldPyramid) into a level.width x level.height buffer.
+ColorizeStatus colorizeLevel(const GribField& field, int level,
+    const GribViewerSettings& settings, std::vector<Color>& imgData);
+ColorizeStatus colorizeLevelIndexed(const GribField& field, int level,
+    const GribViewerSettings& settings, std::vector<unsigned char>& indices);
+
+void colorizeColorbar(int width, int height, const GribViewerSettings& settings,
+    std::vector<Color>& data);
@@ -0,0 +1,172 @@
+#include "file_pool.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+FilePool& FilePool::instance() {
+    static FilePool pool;
+    return pool;
+}
+
+FilePool::FilePool() {
+    rlimit rl{};
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY)
+        limit = std::max<size_t>(16, static_cast<size_t>(rl.rlim_cur) / 4);
+    else
+        limit = 256;
+    if (const char* env = std::getenv("GRIBVIEWER_MAX_OPEN_FILES")) {
+        long n = std::strtol(env, nullptr, 10);
+        if (n > 0) limit = static_cast<size_t>(n);
+    }
+}
+
+void FilePool::setCapacity(size_t files) {
+    std::lock_guard<std::mutex> lock(mutex);
+    limit = std::max<size_t>(1, files);
+    while (lru.size() > limit && evictLocked()) {}
+}
+
+size_t FilePool::capacity() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return limit;
+}
+
+int FilePool::add(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    int id;
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+    } else {
+        id = static_cast<int>(entries.size());
+        entries.emplace_back();
+    }
+    Entry& e = entries[id];
+    e = Entry();
+    e.path = path;
+    e.used = true;
+    ++counters.files;
+    return id;
+}
+
+void FilePool::remove(int id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (id < 0 || id >= static_cast<int>(entries.size()) || !entries[id].used) return;
+    Entry& e = entries[id];
+    --counters.files;
+    if (e.pins > 0) {
+        e.removing = true;  // the last release frees it
+        return;
+    }
+    closeLocked(e);
+    e.used = false;
+    e.path.clear();
+    freeIds.push_back(id);
+}
+
+void FilePool::closeLocked(Entry& e) {
+    if (e.fd < 0) return;
+    ::close(e.fd);
+    e.fd = -1;
+    lru.erase(e.lruPos);
+}
+
+// Closes the least recently used file that is not being read.
+bool FilePool::evictLocked() {
+    for (auto it = lru.rbegin(); it != lru.rend(); ++it) {
+        Entry& e = entries[*it];
+        if (e.pins == 0) {
+            closeLocked(e);
+            ++counters.evictions;
+            return true;
+        }
+    }
+    return false;
+}
+
+FilePool::Handle FilePool::acquire(int id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (id < 0 || id >= static_cast<int>(entries.size()) || !entries[id].used ||
+        entries[id].removing)
+        return Handle();
+    Entry& e = entries[id];
+    if (e.fd >= 0) {
+        ++counters.hits;
+        lru.splice(lru.begin(), lru, e.lruPos);
+    } else {
+        TRACE_SCOPE("openFile", "io");
+        // if every open file is being read, go over the limit rather than wait
+        while (lru.size() >= limit && evictLocked()) {}
+        int fd = ::open(e.path.c_str(), O_RDONLY | O_CLOEXEC);
+        // descriptors held elsewhere in the process can still exhaust the limit
+        while (fd < 0 && (errno == EMFILE || errno == ENFILE) && evictLocked())
+            fd = ::open(e.path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return Handle();
+        e.fd = fd;
+        lru.push_front(id);
+        e.lruPos = lru.begin();
+        ++counters.opens;
+    }
+    ++e.pins;
+    return Handle(this, id, e.fd);
+}
+
+void FilePool::release(int id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry& e = entries[id];
+    if (--e.pins > 0) return;
+    if (e.removing) {
+        closeLocked(e);
+        e = Entry();
+        freeIds.push_back(id);
+    } else if (lru.size() > limit) {
+        evictLocked();
+    }
+}
+
+bool FilePool::readAt(int id, void* buffer, size_t length, uint64_t offset) {
+    Handle file = acquire(id);
+    if (!file) return false;
+    char* out = static_cast<char*>(buffer);
+    size_t done = 0;
+    while (done < length) {
+        ssize_t n = pread(file.fd(), out + done, length - done, static_cast<off_t>(offset + done));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        done += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+FilePool::Stats FilePool::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats s = counters;
+    s.open = lru.size();
+    return s;
+}
+
+FilePool::Handle& FilePool::Handle::operator=(Handle&& o) noexcept {
+    if (this != &o) {
+        reset();
+        pool = o.pool;
+        id = o.id;
+        descriptor = o.descriptor;
+        o.pool = nullptr;
+        o.id = -1;
+        o.descriptor = -1;
+    }
+    return *this;
+}
+
+void FilePool::Handle::reset() {
+    if (pool) pool->release(id);
+    pool = nullptr;
+    id = -1;
+    descriptor = -1;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Bounds the number of open file descriptors across all readers. Files are
+// registered by path and opened on first use; when the pool is full the least
+// recently used file that no read is using is closed, and reopened later if
+// needed. All reads are positioned (pread), so no per-file cursor exists and
+// any thread can read any file.
+class FilePool {
+public:
+    static FilePool& instance();
+
+    FilePool(const FilePool&) = delete;
+    FilePool& operator=(const FilePool&) = delete;
+
+    // Default: a quarter of the soft RLIMIT_NOFILE, at least 16.
+    // GRIBVIEWER_MAX_OPEN_FILES overrides it.
+    void setCapacity(size_t files);
+    size_t capacity() const;
+
+    // Returns an id for acquire/readAt; the file is not opened yet.
+    int add(const std::string& path);
+    // Closes the file (after the last Handle on it is gone) and frees the id.
+    void remove(int id);
+
+    // Keeps the file's descriptor open while it exists.
+    class Handle {
+    public:
+        Handle() = default;
+        Handle(Handle&& o) noexcept { *this = std::move(o); }
+        Handle& operator=(Handle&& o) noexcept;
+        ~Handle() { reset(); }
+
+        int fd() const { return descriptor; }
+        explicit operator bool() const { return descriptor >= 0; }
+        void reset();
+
+    private:
+        friend class FilePool;
+        Handle(FilePool* pool, int id, int fd) : pool(pool), id(id), descriptor(fd) {}
+
+        FilePool* pool = nullptr;
+        int id = -1;
+        int descriptor = -1;
+    };
+
+    // Opens the file if needed; an empty handle if that fails.
+    Handle acquire(int id);
+    // Reads exactly `length` bytes at `offset`.
+    bool readAt(int id, void* buffer, size_t length, uint64_t offset);
+
+    struct Stats {
+        size_t files = 0;       // registered
+        size_t open = 0;
+        size_t opens = 0;       // including reopens after eviction
+        size_t evictions = 0;
+        size_t hits = 0;        // acquires that found the file open
+    };
+    Stats stats() const;
+
+private:
+    FilePool();
+
+    struct Entry {
+        std::string path;
+        int fd = -1;
+        int pins = 0;
+        bool used = false;
+        bool removing = false;
+        std::list<int>::iterator lruPos;
+    };
+
+    void release(int id);
+    void closeLocked(Entry& e);
+    bool evictLocked();
+
+    mutable std::mutex mutex;
+    std::vector<Entry> entries;
+    std::vector<int> freeIds;
+    std::list<int> lru;  // open files, most recently used first
+    size_t limit = 16;
+    Stats counters;
+};
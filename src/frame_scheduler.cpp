@@ -0,0 +1,85 @@
+#include "frame_scheduler.h"
+
+#include <GLFW/glfw3.h>
+#include <imgui.h>
+
+#include "trace.h"
+
+FrameScheduler& FrameScheduler::instance() {
+    static FrameScheduler scheduler;
+    return scheduler;
+}
+
+void FrameScheduler::requestFrame() {
+    dirty.store(true);
+    // glfwPostEmptyEvent is thread-safe; only needed if the loop is asleep
+    if (waiting.load()) glfwPostEmptyEvent();
+}
+
+void FrameScheduler::requestFrameAt(Clock::time_point at) {
+    {
+        std::lock_guard<std::mutex> lock(deadlineMutex);
+        if (at >= deadline) return;
+        deadline = at;
+    }
+    // wake the loop so it sleeps again with the shorter timeout
+    if (waiting.load()) {
+        rescheduled.store(true);
+        glfwPostEmptyEvent();
+    }
+}
+
+void FrameScheduler::waitForFrame() {
+    ++frames;
+    if (continuous || dirty.exchange(false)) {
+        glfwPollEvents();
+        return;
+    }
+    if (settle > 0) {
+        --settle;
+        glfwPollEvents();
+        return;
+    }
+
+    TRACE_SCOPE("idle", "ui");
+    const Clock::time_point sleepStart = Clock::now();
+    for (;;) {
+        Clock::time_point until;
+        {
+            std::lock_guard<std::mutex> lock(deadlineMutex);
+            until = deadline;
+        }
+        const Clock::time_point now = Clock::now();
+        if (until <= now) break;
+
+        waiting.store(true);
+        // a request that arrived before `waiting` was set did not post an event
+        if (!dirty.load()) {
+            if (until == Clock::time_point::max())
+                glfwWaitEvents();
+            else
+                glfwWaitEventsTimeout(std::chrono::duration<double>(until - now).count());
+        }
+        waiting.store(false);
+        if (!rescheduled.exchange(false)) break;
+    }
+    idle += std::chrono::duration<double>(Clock::now() - sleepStart).count();
+
+    bool tick = false;
+    {
+        std::lock_guard<std::mutex> lock(deadlineMutex);
+        if (deadline <= Clock::now()) {
+            deadline = Clock::time_point::max();
+            tick = true;
+        }
+    }
+    // neither a tick nor a request: woken by input
+    if (!dirty.exchange(false) && !tick)
+        settle = settleFrames - 1;
+}
+
+void FrameScheduler::endFrame() {
+    // keep the text cursor blinking and let hover tooltips appear after their delay
+    if (ImGui::GetIO().WantTextInput || ImGui::IsAnyItemHovered())
+        requestFrameIn(0.5);
+}
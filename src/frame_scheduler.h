@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+// Decides when the main loop draws. Instead of polling and redrawing at vsync
+// rate forever, the loop sleeps in glfwWaitEvents until something makes the
+// UI dirty: input, a job finishing, or a scheduled animation tick.
+class FrameScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // ImGui needs a couple of frames after input to settle hover and layout.
+    static constexpr int settleFrames = 3;
+
+    static FrameScheduler& instance();
+
+    // Draw another frame as soon as possible. Safe from any thread; work that
+    // progresses a little each frame calls this every frame until it is done.
+    void requestFrame();
+    // Draw a frame no later than `at` (animation ticks, blinking cursor).
+    void requestFrameAt(Clock::time_point at);
+    void requestFrameIn(double seconds) {
+        requestFrameAt(Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                                          std::chrono::duration<double>(seconds)));
+    }
+
+    // Called at the top of each frame in place of glfwPollEvents; blocks while
+    // there is nothing to draw.
+    void waitForFrame();
+    // Called after the UI is built; schedules frames ImGui itself needs.
+    void endFrame();
+
+    // Redraw every frame regardless (for comparing against the old loop).
+    bool continuous = false;
+
+    unsigned long framesDrawn() const { return frames; }
+    double idleSeconds() const { return idle; }
+
+private:
+    FrameScheduler() = default;
+
+    std::atomic<bool> dirty{true};
+    std::atomic<bool> waiting{false};
+    std::atomic<bool> rescheduled{false};
+    std::mutex deadlineMutex;
+    Clock::time_point deadline = Clock::time_point::max();
+    int settle = 0;
+    unsigned long frames = 0;
+    double idle = 0.;
+};
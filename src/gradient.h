@@ -1,8 +1,8 @@
 #pragma once
 
+#include <algorithm>
 #include <cmath>
-#include <vector>
-#include <GL/gl.h>
+#include <cstddef>
 #include <iostream>
 
 struct Color {
@@ -31,66 +31,122 @@ inline Color srgb2linear(const Color& c) {
     );
 }
 
+// Compile-time sRGB decoding, so gradient tables can carry their linear-light
+// colours without running std::pow at startup or per lookup.
+namespace constexpr_srgb {
+
+constexpr double ln2 = 0.6931471805599453;
+
+constexpr double exp(double x) {
+    int k = static_cast<int>(x / ln2 + (x >= 0 ? 0.5 : -0.5));
+    double r = x - k * ln2;
+    double term = 1.0, sum = 1.0;
+    for (int i = 1; i < 25; ++i) {
+        term *= r / i;
+        sum += term;
+    }
+    for (; k > 0; --k) sum *= 2.0;
+    for (; k < 0; ++k) sum *= 0.5;
+    return sum;
+}
+
+constexpr double log(double x) {
+    int k = 0;
+    for (; x >= 2.0; ++k) x *= 0.5;
+    for (; x < 1.0; --k) x *= 2.0;
+    double y = (x - 1.0) / (x + 1.0);
+    double term = y, sum = 0.0;
+    for (int i = 1; i < 60; i += 2) {
+        sum += term / i;
+        term *= y * y;
+    }
+    return 2.0 * sum + k * ln2;
+}
+
+constexpr float toLinear(float c) {
+    return c <= 0.04045f ? c / 12.92f
+                         : static_cast<float>(exp(2.4 * log((c + 0.055) / 1.055)));
+}
+
+constexpr float toSrgb(double c) {
+    return static_cast<float>(c <= 0.0031308 ? 12.92 * c : 1.055 * exp(log(c) / 2.4) - 0.055);
+}
+
+// Encoded values at c = i / N, i = 0 .. N.
+template <size_t N>
+struct EncodeTable {
+    float v[N + 1];
+};
+
+template <size_t N>
+constexpr EncodeTable<N> encodeTable() {
+    EncodeTable<N> out{};
+    for (size_t i = 0; i <= N; ++i)
+        out.v[i] = toSrgb(static_cast<double>(i) / N);
+    return out;
+}
+
+template <size_t N>
+struct LinearTable {
+    float v[N][3];
+};
+
+template <size_t N>
+constexpr LinearTable<N> toLinear(const float (&srgb)[N][3]) {
+    LinearTable<N> out{};
+    for (size_t i = 0; i < N; ++i)
+        for (size_t c = 0; c < 3; ++c)
+            out.v[i][c] = toLinear(srgb[i][c]);
+    return out;
+}
+
+}  // namespace constexpr_srgb
+
+// sRGB encoding of linear-light values in [0, 1] by interpolating a
+// compile-time table: within 1e-4 of linear2srgb, without its std::pow calls.
+inline constexpr size_t srgbEncodeSteps = 4096;
+extern const constexpr_srgb::EncodeTable<srgbEncodeSteps> srgbEncode;  // gradient_registry.cpp
+
+inline float encodeSrgb(float c) {
+    const float x = std::clamp(c, 0.f, 1.f) * static_cast<float>(srgbEncodeSteps);
+    const size_t i = std::min(static_cast<size_t>(x), srgbEncodeSteps - 1);
+    const float f = x - static_cast<float>(i);
+    return srgbEncode.v[i] + f * (srgbEncode.v[i + 1] - srgbEncode.v[i]);
+}
+
+inline Color encodeSrgb(const Color& c) {
+    return Color(encodeSrgb(c.r), encodeSrgb(c.g), encodeSrgb(c.b));
+}
+
+// A colormap over [0, 1] with uniformly spaced colour stops. It is a view of
+// static sRGB and linear-light tables, so lookups are O(1), encode through
+// srgbEncode rather than std::pow, and copying it never allocates.
 class Gradient {
     public:
-    std::vector<Color> colors;
-    std::vector<float> positions; // 0 to 1
-    GLuint previewTexture = 0;
-    std::vector<Color> previewData;
-    Gradient() {
-        // Default gradient: black to white
-        colors.push_back(Color(0.0f));
-        colors.push_back(Color(1.0f));
-        positions.push_back(0.0f);
-        positions.push_back(1.0f);
-    }   
-    Gradient(const std::vector<Color>& colors, const std::vector<float>& positions) : colors(colors), positions(positions) {}
-    ~Gradient() {
-        if (previewTexture != 0) {
-            glDeleteTextures(1, &previewTexture);
-        }
-    }
+    const float (*srgb)[3];
+    const float (*linear)[3];
+    int count;
+
+    template <size_t N>
+    constexpr Gradient(const float (&srgb)[N][3], const float (&linear)[N][3])
+        : srgb(srgb), linear(linear), count(static_cast<int>(N)) {}
+
+    Color stop(int i) const { return Color(srgb[i][0], srgb[i][1], srgb[i][2]); }
+    Color linearStop(int i) const { return Color(linear[i][0], linear[i][1], linear[i][2]); }
+
     Color get_color(float t, bool old_bug = false) const {
-        if (t <= positions.front()) return colors.front();
-        if (t >= positions.back()) return colors.back();
-        for (size_t i = 0; i < positions.size() - 1; ++i) {
-            if (t >= positions[i] && t <= positions[i + 1]) {
-                float local_t = (t - positions[i]) / (positions[i + 1] - positions[i]);
-                if (!old_bug)
-                    return linear2srgb(srgb2linear(colors[i + 1]) * local_t + srgb2linear(colors[i]) * (1.f - local_t));
-                else
-                    return linear2srgb(Color(
-                        colors[i].r + local_t * (colors[i + 1].r - colors[i].r),
-                        colors[i].g + local_t * (colors[i + 1].g - colors[i].g),
-                        colors[i].b + local_t * (colors[i + 1].b - colors[i].b)
-                    ));
-            }
-        }
-        return Color(1.f, 0.f, 1.f); // Should never reach here
-    }
-    void makePreview() {
-        // Create a 256x1 preview texture
-        const int previewWidth = 256;
-        const int previewHeight = 16;
-        previewData.resize(previewWidth * previewHeight);
-        for (int x = 0; x < previewWidth; ++x) {
-            float t = static_cast<float>(x) / (previewWidth - 1);
-            Color col = get_color(t);
-            for (int y = 0; y < previewHeight; ++y) {
-                previewData[y * previewWidth + x] = col;
-            }
-        }
-        if (previewTexture == 0)
-            glGenTextures(1, &previewTexture);
-        
-        glBindTexture(GL_TEXTURE_2D, previewTexture);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, previewWidth, previewHeight, 0, GL_RGB, GL_FLOAT, nullptr);
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, previewWidth, previewHeight, GL_RGB, GL_FLOAT, previewData.data());
-        glBindTexture(GL_TEXTURE_2D, 0);
+        if (t <= 0.f) return stop(0);
+        if (t >= 1.f) return stop(count - 1);
+        float x = t * static_cast<float>(count - 1);
+        int i = std::min(static_cast<int>(x), count - 2);
+        float local_t = x - static_cast<float>(i);
+        if (!old_bug)
+            return encodeSrgb(linearStop(i + 1) * local_t + linearStop(i) * (1.f - local_t));
+        else
+            return encodeSrgb(Color(
+                srgb[i][0] + local_t * (srgb[i + 1][0] - srgb[i][0]),
+                srgb[i][1] + local_t * (srgb[i + 1][1] - srgb[i][1]),
+                srgb[i][2] + local_t * (srgb[i + 1][2] - srgb[i][2])
+            ));
     }
 };
-
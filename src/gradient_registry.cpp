@@ -0,0 +1,38 @@
+#include "gradient_registry.h"
+
+#include "mpl_gradients.h"
+
+// evaluated once here rather than in every file that includes gradient.h
+constexpr constexpr_srgb::EncodeTable<srgbEncodeSteps> srgbEncode =
+    constexpr_srgb::encodeTable<srgbEncodeSteps>();
+
+const GradientRegistry& GradientRegistry::instance() {
+    static const GradientRegistry registry(mpl_gradients, mpl_gradient_names, mpl_gradient_count);
+    return registry;
+}
+
+GradientRegistry::GradientRegistry(const Gradient* g, const char* const* n, size_t c)
+    : gradients(g), names(n), count(c), luts(new LutSlot[c]) {
+}
+
+GradientHandle GradientRegistry::find(const std::string& gradientName) const {
+    for (size_t i = 0; i < count; ++i) {
+        if (gradientName == names[i]) return static_cast<GradientHandle>(i);
+    }
+    return invalidGradient;
+}
+
+const GradientLut& GradientRegistry::lut(GradientHandle h, bool oldColorBug) const {
+    LutSlot& slot = luts[h];
+    const int variant = oldColorBug ? 1 : 0;
+    std::call_once(slot.built[variant], [&]() {
+        const Gradient& grad = gradient(h);
+        std::vector<Color>& colors = slot.lut[variant].colors;
+        colors.resize(GradientLut::size);
+        for (int i = 0; i < GradientLut::size; ++i) {
+            float t = static_cast<float>(i) / static_cast<float>(GradientLut::size - 1);
+            colors[i] = grad.get_color(t, oldColorBug);
+        }
+    });
+    return slot.lut[variant];
+}
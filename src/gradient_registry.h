@@ -0,0 +1,52 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "gradient.h"
+
+// Settings refer to colormaps by handle: an index into the registry.
+using GradientHandle = uint32_t;
+constexpr GradientHandle invalidGradient = UINT32_MAX;
+
+// High-resolution sampling of one gradient: entry i is get_color(i / (size - 1)).
+struct GradientLut {
+    static constexpr int size = 4096;
+    std::vector<Color> colors;
+
+    const Color& sample(float t) const {
+        int idx = static_cast<int>(std::clamp(t, 0.f, 1.f) * (size - 1) + 0.5f);
+        return colors[idx];
+    }
+};
+
+// Immutable set of all known gradients. Each gradient's LUT is built on first
+// use and then shared read-only by every renderer, on any thread.
+class GradientRegistry {
+public:
+    static const GradientRegistry& instance();
+
+    size_t size() const { return count; }
+    const Gradient& gradient(GradientHandle h) const { return gradients[h]; }
+    const char* name(GradientHandle h) const { return names[h]; }
+    GradientHandle find(const std::string& name) const;
+
+    const GradientLut& lut(GradientHandle h, bool oldColorBug = false) const;
+
+private:
+    GradientRegistry(const Gradient* gradients, const char* const* names, size_t count);
+
+    struct LutSlot {
+        std::once_flag built[2];
+        GradientLut lut[2];
+    };
+
+    const Gradient* gradients;
+    const char* const* names;
+    size_t count;
+    std::unique_ptr<LutSlot[]> luts;
+};
@@ -5,6 +5,8 @@
 #include <set>
 #include <sstream>
 
+#include "trace.h"
+
 FieldIdentity fieldIdentityOf(const GribMessageInfo& m) {
     return FieldIdentity{
         m.indicatorOfParameter,
@@ -29,6 +31,7 @@ void GribCollection::clear() {
     lookupByGlobal.clear();
     identityIndex.clear();
     duplicateWarnings.clear();
+    indexMemory.set(0);
     currentField = GribField{};
     currentGlobalIndex = 0;
 }
@@ -44,6 +47,7 @@ void GribCollection::beginLoad(const std::vector<std::string>& paths) {
 }
 
 bool GribCollection::loadNext() {
+    TRACE_SCOPE("loadNext", "io");
     if (!loading) return false;
     if (loadCursor >= pendingPaths.size()) {
         finalizeLoad();
@@ -60,10 +64,13 @@ bool GribCollection::loadNext() {
             info.fileIdx = fi;
             info.globalIndex = messageList.size();
             lookupByGlobal.push_back({fi, info.indexInFile});
-            messageList.push_back(info);
+            messageList.push_back(std::move(info));
         }
+        // the collection owns the metadata from here on; don't keep a second copy
+        std::vector<GribMessageInfo>().swap(reader->messageList);
     }
     readers.push_back(std::move(reader));
+    updateMemory();
     ++loadCursor;
     if (loadCursor >= pendingPaths.size()) {
         finalizeLoad();
@@ -73,6 +80,7 @@ bool GribCollection::loadNext() {
 }
 
 void GribCollection::finalizeLoad() {
+    TRACE_SCOPE("finalizeLoad", "index");
     loading = false;
     fileLoaded = !messageList.empty();
 
@@ -107,11 +115,35 @@ void GribCollection::finalizeLoad() {
         }
     }
 
+    updateMemory();
+
     if (fileLoaded) {
         readField(0, currentField);
     }
 }
 
+static size_t stringHeap(const std::string& s) {
+    // libstdc++ keeps up to 15 chars inline
+    return s.capacity() > 15 ? s.capacity() + 1 : 0;
+}
+
+void GribCollection::updateMemory() {
+    size_t bytes = messageList.capacity() * sizeof(GribMessageInfo) +
+                   lookupByGlobal.capacity() * sizeof(lookupByGlobal[0]);
+    for (const auto& m : messageList) {
+        bytes += stringHeap(m.name) + stringHeap(m.shortName) + stringHeap(m.units) +
+                 stringHeap(m.indicatorOfTypeOfLevel) + stringHeap(m.typeOfLevel) +
+                 stringHeap(m.typeOfFirstFixedSurface) + stringHeap(m.stepUnits);
+    }
+    for (const auto& reader : readers)
+        bytes += sizeof(GribReader) + reader->indexBytes();
+    // node, bucket and key overhead of the identity index, roughly
+    for (const auto& [id, globals] : identityIndex)
+        bytes += sizeof(id) + sizeof(globals) + 2 * sizeof(void*) + globals.capacity() * sizeof(size_t);
+    bytes += identityIndex.bucket_count() * sizeof(void*);
+    indexMemory.set(bytes);
+}
+
 bool GribCollection::readField(size_t globalIndex, GribField& field) {
     if (globalIndex >= lookupByGlobal.size()) return false;
     auto [fileIdx, indexInFile] = lookupByGlobal[globalIndex];
@@ -121,8 +153,124 @@ bool GribCollection::readField(size_t globalIndex, GribField& field) {
     return ok;
 }
 
+bool GribCollection::readFieldAt(size_t globalIndex, GribField& field,
+    std::vector<unsigned char>& scratch, bool buildPyramid) const {
+    if (globalIndex >= lookupByGlobal.size()) return false;
+    auto [fileIdx, indexInFile] = lookupByGlobal[globalIndex];
+    if (fileIdx >= readers.size()) return false;
+    if (!readers[fileIdx]->readMessage(indexInFile, scratch)) return false;
+    return readers[fileIdx]->readFieldFromMessage(scratch, field, buildPyramid);
+}
+
 const std::vector<size_t>* GribCollection::stepsFor(const FieldIdentity& id) const {
     auto it = identityIndex.find(id);
     if (it == identityIndex.end()) return nullptr;
     return &it->second;
 }
+
+void GribCollection::seriesFor(const GribMessageInfo& current, AnimationAxis axis,
+    std::vector<size_t>& out) const {
+    TRACE_SCOPE("seriesFor", "index");
+    out.clear();
+    FieldIdentity id = fieldIdentityOf(current);
+    auto sameTime = [&](const GribMessageInfo& m) {
+        return m.step == current.step && m.validityDate == current.validityDate &&
+               m.validityTime == current.validityTime;
+    };
+    std::vector<const GribMessageInfo*> members;
+    for (const auto& m : messageList) {
+        bool match = false;
+        switch (axis) {
+            case AnimationAxis::Step:
+                match = m.perturbationNumber == current.perturbationNumber &&
+                        fieldIdentityOf(m) == id;
+                break;
+            case AnimationAxis::Level: {
+                FieldIdentity other = fieldIdentityOf(m);
+                other.level = id.level;
+                match = m.perturbationNumber == current.perturbationNumber && sameTime(m) &&
+                        other == id;
+                break;
+            }
+            case AnimationAxis::Member:
+                match = sameTime(m) && fieldIdentityOf(m) == id;
+                break;
+        }
+        if (match) members.push_back(&m);
+    }
+
+    // same order as identityIndex for steps
+    std::sort(members.begin(), members.end(),
+              [axis](const GribMessageInfo* a, const GribMessageInfo* b) {
+                  if (axis == AnimationAxis::Level && a->level != b->level)
+                      return a->level < b->level;
+                  if (axis == AnimationAxis::Member &&
+                      a->perturbationNumber != b->perturbationNumber)
+                      return a->perturbationNumber < b->perturbationNumber;
+                  if (a->step != b->step) return a->step < b->step;
+                  if (a->validityDate != b->validityDate) return a->validityDate < b->validityDate;
+                  if (a->validityTime != b->validityTime) return a->validityTime < b->validityTime;
+                  if (a->fileIdx != b->fileIdx) return a->fileIdx < b->fileIdx;
+                  return a->globalIndex < b->globalIndex;
+              });
+    out.reserve(members.size());
+    for (const GribMessageInfo* m : members) out.push_back(m->globalIndex);
+}
+
+bool compareByKey(const GribMessageInfo& a,
+                  const GribMessageInfo& b,
+                  SortKey key)
+{
+    switch (key)
+    {
+        case SortKey::Name: return a.name < b.name;
+        case SortKey::ShortName: return a.shortName < b.shortName;
+        case SortKey::IndicatorOfParameter:
+            return a.indicatorOfParameter < b.indicatorOfParameter;
+        case SortKey::ParameterNumber:
+            return a.parameterNumber < b.parameterNumber;
+        case SortKey::Level:
+            return a.level < b.level;
+        case SortKey::PerturbationNumber:
+            return a.perturbationNumber < b.perturbationNumber;
+        case SortKey::IndicatorOfTypeOfLevel:
+            return a.indicatorOfParameter < b.indicatorOfParameter;
+        case SortKey::ParameterCategory:
+            return a.parameterCategory < b.parameterCategory;
+        case SortKey::Discipline:
+            return a.discipline < b.discipline;
+        case SortKey::TypeOfLevel:
+            return a.typeOfLevel < b.typeOfLevel;
+        case SortKey::typeOfFirstFixedSurface:
+            return a.typeOfFirstFixedSurface < b.typeOfFirstFixedSurface;
+        case SortKey::IndexInFile:
+            return a.indexInFile < b.indexInFile;
+        case SortKey::Step:
+            return a.step < b.step;
+        case SortKey::ValidityDateTime:
+            if (a.validityDate != b.validityDate) return a.validityDate < b.validityDate;
+            return a.validityTime < b.validityTime;
+        case SortKey::FileIdx:
+            return a.fileIdx < b.fileIdx;
+    }
+    return false;
+}
+
+void sortWithOrder(std::vector<GribMessageInfo>& list,
+                   const std::vector<SortColumn>& order)
+{
+    TRACE_SCOPE("sortMessages", "index");
+    std::sort(list.begin(), list.end(),
+        [&](const auto& a, const auto& b)
+        {
+            for (const auto& col : order)
+            {
+                if (compareByKey(a, b, col.key))
+                    return col.ascending;
+
+                if (compareByKey(b, a, col.key))
+                    return !col.ascending;
+            }
+            return false;
+        });
+}
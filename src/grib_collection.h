@@ -50,6 +50,17 @@ struct FieldIdentityHash {
 
 FieldIdentity fieldIdentityOf(const GribMessageInfo& m);
 
+// What an animation steps through, starting from the shown message.
+enum class AnimationAxis {
+    Step,    // forecast steps of the same field and member
+    Level,   // levels of the same parameter at the same step and member
+    Member   // ensemble members of the same field at the same step
+};
+
+bool compareByKey(const GribMessageInfo& a, const GribMessageInfo& b, SortKey key);
+// Multi-column order: earlier columns take precedence.
+void sortWithOrder(std::vector<GribMessageInfo>& list, const std::vector<SortColumn>& order);
+
 class GribCollection {
 public:
     bool fileLoaded = false;
@@ -71,11 +82,20 @@ public:
     void beginLoad(const std::vector<std::string>& paths);
     bool loadNext();
     bool readField(size_t globalIndex, GribField& field);
+    // Safe to call from several threads at once; does not touch currentField.
+    bool readFieldAt(size_t globalIndex, GribField& field, std::vector<unsigned char>& scratch,
+        bool buildPyramid = true) const;
 
     size_t messageCount() const { return messageList.size(); }
 
     const std::vector<size_t>* stepsFor(const FieldIdentity& id) const;
+    // Global indices of the messages along `axis` through `current`, in playback order.
+    void seriesFor(const GribMessageInfo& current, AnimationAxis axis,
+        std::vector<size_t>& out) const;
 
 private:
     void finalizeLoad();
+    void updateMemory();
+
+    MemoryCharge indexMemory{MemCategory::MessageIndex};
 };
@@ -1,7 +1,11 @@
 #include "grib_reader.h"
 
+#include "eccodes_warmup.h"
+#include "memory_tracker.h"
+#include "trace.h"
 
-GribReader::GribReader() : fileHandle(nullptr) {
+
+GribReader::GribReader() {
 }
 
 GribReader::~GribReader() {
@@ -12,24 +16,30 @@ bool GribReader::openFile(const std::string& fname) {
     close();
     
     filename = fname;
-    FILE* f = fopen(filename.c_str(), "rb");
-    if (!f) {
+    // registered with the pool, which opens and closes it as reads need it
+    fileId = FilePool::instance().add(filename);
+    if (!file()) {
         lastError = "Cannot open file: " + filename;
+        close();
         return false;
     }
-    
-    fileHandle = f;
     return true;
 }
 
 void GribReader::loadFile(char filename[512]) {
+    TRACE_SCOPE("scanFile", "io");
     if (!openFile(filename)) return;
+    waitEccodesWarmup();
+    // ecCodes scans a stream; only this pass uses a FILE, closed when done
+    FILE* f = fopen(filename, "rb");
+    if (!f) {
+        lastError = std::string("Cannot open file: ") + filename;
+        return;
+    }
     fileLoaded = true;
 
-    FILE* f = static_cast<FILE*>(fileHandle);
-    fseek(f, 0, SEEK_SET);
-
     messageOffsets.clear();
+    messageLengths.clear();
     messageList.clear();
 
     int err = 0;
@@ -41,45 +51,33 @@ void GribReader::loadFile(char filename[512]) {
         GribMessageInfo info;
         info.indexInFile = static_cast<int>(messageOffsets.size());
         decodeMetadata(h, info);
+        size_t length = 0;
+        codes_get_message_size(h, &length);
         messageOffsets.push_back(offset);
+        messageLengths.push_back(length);
         messageList.push_back(std::move(info));
 
         codes_handle_delete(h);
     }
+    fclose(f);
 
     messageCount = static_cast<int>(messageOffsets.size());
 }
 
 void GribReader::close() {
-    if (fileHandle) {
-        fclose(static_cast<FILE*>(fileHandle));
-        fileHandle = nullptr;
+    if (fileId >= 0) {
+        FilePool::instance().remove(fileId);
+        fileId = -1;
     }
 }
 
 int GribReader::getMessageCount() const {
-    if (!fileHandle) return 0;
-    
-    FILE* f = static_cast<FILE*>(fileHandle);
-    long currentPos = ftell(f);
-    fseek(f, 0, SEEK_SET);
-    
-    int count = 0;
-    int err = 0;
-    codes_handle* h = nullptr;
-    
-    while ((h = codes_handle_new_from_file(nullptr, f, PRODUCT_GRIB, &err)) != nullptr) {
-        count++;
-        codes_handle_delete(h);
-    }
-    
-    fseek(f, currentPos, SEEK_SET);
-    return count;
+    return fileId >= 0 ? static_cast<int>(messageOffsets.size()) : 0;
 }
 
 void GribReader::getMessageOffsets() {
-    FILE* f = static_cast<FILE*>(fileHandle);
-    fseek(f, 0, SEEK_SET);
+    FILE* f = fopen(filename.c_str(), "rb");
+    if (!f) return;
     int err = 0;
     messageOffsets.clear();
     
@@ -91,9 +89,10 @@ void GribReader::getMessageOffsets() {
         messageOffsets.push_back(offset);
         codes_handle_delete(h);
     }    
+    fclose(f);
 }
 
-bool GribReader::readCode(codes_handle* h, const char* name, std::string& value) {
+bool GribReader::readCode(codes_handle* h, const char* name, std::string& value) const {
     if (codes_is_defined(h, name) == true) {
         size_t len = 256;
         char buffer[256];
@@ -105,7 +104,7 @@ bool GribReader::readCode(codes_handle* h, const char* name, std::string& value)
     else return false;
 }
 
-bool GribReader::readCode(codes_handle* h, const char* name, long& value) {
+bool GribReader::readCode(codes_handle* h, const char* name, long& value) const {
     if (codes_is_defined(h, name) == true) {
         CODES_CHECK(codes_get_long(h, name, &value), 0);
         return true;
@@ -113,7 +112,7 @@ bool GribReader::readCode(codes_handle* h, const char* name, long& value) {
     else return false;
 }
 
-bool GribReader::readCode(codes_handle* h, const char* name, bool& value) {
+bool GribReader::readCode(codes_handle* h, const char* name, bool& value) const {
     long val = false;
     if (codes_is_defined(h, name) == true) {
         CODES_CHECK(codes_get_long(h, name, &val), 0);
@@ -124,19 +123,50 @@ bool GribReader::readCode(codes_handle* h, const char* name, bool& value) {
 }
 
 bool GribReader::readField(int messageIndex, GribField& field) {
-    if (!fileHandle) {
+    TRACE_SCOPE("readField", "io");
+    if (fileId < 0) {
         lastError = "No file open";
         return false;
     }
     
-    FILE* f = static_cast<FILE*>(fileHandle);
+    // kept between calls, so browsing does not allocate a message buffer each
+    // time, unless an unusually large message left it too big to hold on to
+    struct MessageBuffer {
+        std::vector<unsigned char> bytes;
+        MemoryCharge memory{MemCategory::MessageBuffers};
+    };
+    constexpr size_t keptBytes = size_t(64) << 20;
+    thread_local MessageBuffer buffer;
+    const bool ok = readMessage(messageIndex, buffer.bytes) &&
+                    readFieldFromMessage(buffer.bytes, field);
+    if (buffer.bytes.capacity() > keptBytes) std::vector<unsigned char>().swap(buffer.bytes);
+    buffer.memory.set(buffer.bytes.capacity());
+    return ok;
+}
 
-    fseek(f, messageOffsets[messageIndex], SEEK_SET);
+bool GribReader::readMessage(int messageIndex, std::vector<unsigned char>& bytes) const {
+    TRACE_SCOPE("readMessage", "io");
+    if (fileId < 0 || messageIndex < 0 || messageIndex >= static_cast<int>(messageLengths.size()))
+        return false;
 
-    int err = 0;
-    codes_handle* h = codes_handle_new_from_file(nullptr, f, PRODUCT_GRIB, &err);
+    // positioned reads share no file cursor, so workers can read concurrently
+    bytes.resize(messageLengths[messageIndex]);
+    return FilePool::instance().readAt(fileId, bytes.data(), bytes.size(),
+                                       static_cast<uint64_t>(messageOffsets[messageIndex]));
+}
+
+bool GribReader::readFieldFromMessage(const std::vector<unsigned char>& bytes, GribField& field,
+    bool buildPyramid) const {
+    codes_handle* h = codes_handle_new_from_message(nullptr, bytes.data(), bytes.size());
     if (!h) return false;
-    
+    decodeField(h, field, buildPyramid);
+    codes_handle_delete(h);
+    Tracer::instance().markFirstField();
+    return true;
+}
+
+void GribReader::decodeField(codes_handle* h, GribField& field, bool buildPyramid) const {
+    TRACE_SCOPE("decodeField", "decode");
     // Read metadata
     if (! readCode(h, "name", field.name))
         field.name = "~";
@@ -171,25 +201,49 @@ bool GribReader::readField(int messageIndex, GribField& field) {
     if (! readCode(h, "perturbationNumber", field.perturbationNumber))
         field.perturbationNumber = -1;
     
+    // Points left out by a bitmap (or by missing-value packing in GRIB2) are
+    // decoded as missingValue; pick one no real field contains
+    bool bitmapPresent = false;
+    long missingManaged = 0;
+    readCode(h, "bitmapPresent", bitmapPresent);
+    readCode(h, "missingValueManagementUsed", missingManaged);
+    const bool mayHaveMissing = bitmapPresent || missingManaged != 0;
+    double missingValue = 1.0e36;
+    if (mayHaveMissing) {
+        codes_set_double(h, "missingValue", missingValue);
+        codes_get_double(h, "missingValue", &missingValue);
+    }
+
     // Get values
     size_t values_len = 0;
     CODES_CHECK(codes_get_size(h, "values", &values_len), 0);
     
-    field.values.resize(values_len);
+    // a pooled buffer, not zero-filled first: ecCodes overwrites every value
+    if (!field.values.allocate(values_len)) {
+        std::cerr << "Out of memory for " << values_len << " values" << std::endl;
+        field.memory.set(0);
+        field.validMask.clear();
+        field.missingCount = 0;
+        field.pyramid.clear();
+        return;
+    }
     CODES_CHECK(codes_get_double_array(h, "values", field.values.data(), &values_len), 0);
-    
-    // Calculate min/max
-    field.min_value = *std::min_element(field.values.begin(), field.values.end());
-    field.max_value = *std::max_element(field.values.begin(), field.values.end());
-    
-    codes_handle_delete(h);
-
-    field.processScanDirections();
 
-    return true;
+    // min/max of the present values and the validity mask, in one pass
+    field.missingCount = scanValues(field.values.data(), field.values.size(),
+                                    mayHaveMissing ? &missingValue : nullptr, field.validMask,
+                                    field.min_value, field.max_value);
+    field.memory.set(field.values.capacity() * sizeof(double) +
+                     field.validMask.capacity() * sizeof(uint64_t));
+
+    if (buildPyramid)
+        field.pyramid.build(field.values, field.mask(), field.width, field.height);
+    else
+        field.pyramid.clear();
 }
 
 void GribReader::decodeMetadata(codes_handle* h, GribMessageInfo& info) {
+    TRACE_SCOPE("decodeMetadata", "decode");
     if (! readCode(h, "name", info.name))
         info.name = "~";
     if (! readCode(h, "shortName", info.shortName))
@@ -243,21 +297,19 @@ void GribReader::decodeMetadata(codes_handle* h, GribMessageInfo& info) {
 }
 
 bool GribReader::readFieldMetadata(const int messageIndex, GribMessageInfo& info) {
-    if (!fileHandle) {
+    if (fileId < 0) {
         lastError = "No file open";
         return false;
     }
 
     info.indexInFile = messageIndex;
 
-    FILE* f = static_cast<FILE*>(fileHandle);
-    fseek(f, messageOffsets[messageIndex], SEEK_SET);
-
-    int err = 0;
-    codes_handle* h = codes_handle_new_from_file(nullptr, f, PRODUCT_GRIB, &err);
+    std::vector<unsigned char> bytes;
+    if (!readMessage(messageIndex, bytes)) return false;
+    codes_handle* h = codes_handle_new_from_message(nullptr, bytes.data(), bytes.size());
     if (!h) return false;
 
     decodeMetadata(h, info);
     codes_handle_delete(h);
     return true;
-}
\ No newline at end of file
+}
@@ -4,13 +4,16 @@
 #include <algorithm>
 #include <cmath>
 #include <iostream>
-#include <imgui.h>
 
 #include <string>
 #include <vector>
 #include <memory>
 
-#include <imgui.h>
+#include "field_pyramid.h"
+#include "file_pool.h"
+#include "memory_tracker.h"
+#include "value_mask.h"
+#include "value_pool.h"
 
 struct GribField {
     std::string name;
@@ -27,23 +30,20 @@ struct GribField {
     long discipline;
     long parameterCategory;
     long perturbationNumber;
-    std::vector<double> values;
-    double min_value;
+    FieldValues values;  // 64-byte aligned, from the ValuePool; NaN where missing
+    // see value_mask.h; empty when no value is missing
+    std::vector<uint64_t> validMask;
+    size_t missingCount = 0;
+    double min_value;  // of the values present
     double max_value;
+    FieldPyramid pyramid;
     bool jScansPositively = true;
-    ImVec2 uv1;
-    ImVec2 uv2;
+    MemoryCharge memory{MemCategory::FieldValues};
 
-    GribField() : width(0), height(0), min_value(0.0), max_value(0.0) {processScanDirections();}
-    void processScanDirections() {
-        if (jScansPositively) {
-            uv1 = ImVec2(0, 1);
-            uv2 = ImVec2(1, 0);
-        } else {
-            uv1 = ImVec2(0, 0);
-            uv2 = ImVec2(1, 1);
-        }
-    }
+    GribField() : width(0), height(0), min_value(0.0), max_value(0.0) {}
+
+    const uint64_t* mask() const { return validMask.empty() ? nullptr : validMask.data(); }
+    bool isValid(size_t i) const { return validMask.empty() || maskBit(validMask.data(), i); }
 };
 
 struct GribMessageInfo
@@ -115,19 +115,39 @@ public:
     void getMessageOffsets();
     bool get_value(const codes_handle* h, const char* value_name, const int* value, const int& len);
     bool readField(int messageIndex, GribField& field);
+    // Thread-safe: raw message bytes via a positioned read, then decode from memory.
+    bool readMessage(int messageIndex, std::vector<unsigned char>& bytes) const;
+    bool readFieldFromMessage(const std::vector<unsigned char>& bytes, GribField& field,
+        bool buildPyramid = true) const;
+    void decodeField(codes_handle* h, GribField& field, bool buildPyramid = true) const;
     bool readFieldMetadata(const int messageIndex, GribMessageInfo& field);
     void decodeMetadata(codes_handle* h, GribMessageInfo& info);
 
-    bool readCode(codes_handle* h, const char* name, std::string& value);
-    bool readCode(codes_handle* h, const char* name, long& value);
-    bool readCode(codes_handle* h, const char* name, bool& value);
+    bool readCode(codes_handle* h, const char* name, std::string& value) const;
+    bool readCode(codes_handle* h, const char* name, long& value) const;
+    bool readCode(codes_handle* h, const char* name, bool& value) const;
     void readValue(size_t& len, codes_handle* h, char buffer[256], GribField& field);
 
     const std::string& getLastError() const { return lastError; }
+    // Where a message's bytes are in the file, for copying it verbatim.
+    bool messageRange(int messageIndex, long& offset, size_t& length) const {
+        if (messageIndex < 0 || messageIndex >= static_cast<int>(messageLengths.size()))
+            return false;
+        offset = messageOffsets[messageIndex];
+        length = messageLengths[messageIndex];
+        return true;
+    }
+    // The file's descriptor from the FilePool, kept open while the handle lives.
+    FilePool::Handle file() const { return FilePool::instance().acquire(fileId); }
+    // Heap held by the message offset/length index.
+    size_t indexBytes() const {
+        return messageOffsets.capacity() * sizeof(long) + messageLengths.capacity() * sizeof(size_t);
+    }
     
 private:
     std::string filename;
     std::string lastError;
     std::vector<long> messageOffsets;
-    void* fileHandle;
+    std::vector<size_t> messageLengths;
+    int fileId = -1;  // in FilePool
 };
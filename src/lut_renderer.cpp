@@ -0,0 +1,318 @@
+#include "lut_renderer.h"
+
+#include <iostream>
+
+#include "field_render.h"
+#include "task_scheduler.h"
+#include "trace.h"
+
+static const char* lutVertexShader = R"(
+#version 130
+void main() {
+    vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+// valueToColor() and applyHclAdjustments() step by step, on the gradient's own
+// colour stops; keep them in sync. The stops texture holds the linear-light
+// stops followed by the sRGB ones.
+static const char* lutFragmentShader = R"(
+#version 130
+uniform sampler2D field;
+uniform sampler1D stops;
+uniform int stopCount;
+uniform bool oldColorBug;
+uniform float minVal;
+uniform float maxVal;
+uniform bool discreteColors;
+uniform float colorCount;
+uniform bool sqrtScale;
+uniform bool adjust;
+uniform float brightness;
+uniform float gamma;
+uniform float vibrancy;
+uniform float hueShift;
+uniform vec3 missingColor;
+out vec4 fragColor;
+
+vec3 linearStop(int i) { return texelFetch(stops, i, 0).rgb; }
+vec3 srgbStop(int i) { return texelFetch(stops, stopCount + i, 0).rgb; }
+
+float toSrgb(float c) { return c <= 0.0031308 ? 12.92 * c : 1.055 * pow(c, 1.0 / 2.4) - 0.055; }
+float toLinear(float c) { return c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4); }
+vec3 linear2srgb(vec3 c) { return vec3(toSrgb(c.r), toSrgb(c.g), toSrgb(c.b)); }
+vec3 srgb2linear(vec3 c) { return vec3(toLinear(c.r), toLinear(c.g), toLinear(c.b)); }
+
+vec3 gradientColor(float t) {
+    if (t <= 0.0) return srgbStop(0);
+    if (t >= 1.0) return srgbStop(stopCount - 1);
+    float x = t * float(stopCount - 1);
+    int i = min(int(x), stopCount - 2);
+    float localT = x - float(i);
+    if (!oldColorBug)
+        return linear2srgb(linearStop(i + 1) * localT + linearStop(i) * (1.0 - localT));
+    vec3 a = srgbStop(i);
+    return linear2srgb(a + localT * (srgbStop(i + 1) - a));
+}
+
+const float delta = 6.0 / 29.0;
+float labF(float t) {
+    return t > delta * delta * delta ? pow(t, 1.0 / 3.0) : t / (3.0 * delta * delta) + 4.0 / 29.0;
+}
+float labFinv(float t) { return t > delta ? t * t * t : 3.0 * delta * delta * (t - 4.0 / 29.0); }
+
+vec3 hclAdjust(vec3 srgb) {
+    vec3 lin = srgb2linear(srgb);
+    float X = 0.4124564 * lin.r + 0.3575761 * lin.g + 0.1804375 * lin.b;
+    float Y = 0.2126729 * lin.r + 0.7151522 * lin.g + 0.0721750 * lin.b;
+    float Z = 0.0193339 * lin.r + 0.1191920 * lin.g + 0.9503041 * lin.b;
+    float fx = labF(X / 0.95047);
+    float fy = labF(Y);
+    float fz = labF(Z / 1.08883);
+    float L = 116.0 * fy - 16.0;
+    float a = 500.0 * (fx - fy);
+    float b = 200.0 * (fy - fz);
+
+    float C = sqrt(a * a + b * b);
+    float H = atan(b, a);
+    float Ln = pow(clamp(L / 100.0, 0.0, 1.0), gamma);
+    L = clamp(Ln * brightness, 0.0, 1.0) * 100.0;
+    C = max(0.0, C * vibrancy);
+    H += hueShift * 3.14159265358979323846 / 180.0;
+    a = C * cos(H);
+    b = C * sin(H);
+
+    fy = (L + 16.0) / 116.0;
+    fx = fy + a / 500.0;
+    fz = fy - b / 200.0;
+    X = 0.95047 * labFinv(fx);
+    Y = labFinv(fy);
+    Z = 1.08883 * labFinv(fz);
+    vec3 rgb = vec3( 3.2404542 * X - 1.5371385 * Y - 0.4985314 * Z,
+                    -0.9692660 * X + 1.8760108 * Y + 0.0415560 * Z,
+                     0.0556434 * X - 0.2040259 * Y + 1.0572252 * Z);
+    return linear2srgb(clamp(rgb, 0.0, 1.0));
+}
+
+void main() {
+    float value = texelFetch(field, ivec2(gl_FragCoord.xy), 0).r;
+    // missing values are NaN in the field texture
+    if (isnan(value)) {
+        fragColor = vec4(missingColor, 1.0);
+        return;
+    }
+    float normalized = clamp((value - minVal) / (maxVal - minVal), 0.0, 1.0);
+    if (discreteColors)
+        normalized = floor(normalized * colorCount) / (colorCount - 1.0);
+    if (sqrtScale)
+        normalized = sqrt(normalized);
+    vec3 color = gradientColor(normalized);
+    fragColor = vec4(adjust ? hclAdjust(color) : color, 1.0);
+}
+)";
+
+static GLuint compileShader(GLenum type, const char* source) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+    GLint ok = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        std::cerr << "LUT shader compile failed: " << log << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+static void setTextureParams(GLenum target) {
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    if (target == GL_TEXTURE_2D)
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+LutRenderer::LutRenderer() {
+}
+
+// GL objects are not released here: the renderer outlives the GL context in
+// main(), the same as the textures created by Renderer::createTexture.
+LutRenderer::~LutRenderer() {
+}
+
+bool LutRenderer::init() {
+    if (initTried) return available();
+    initTried = true;
+
+    GLuint vs = compileShader(GL_VERTEX_SHADER, lutVertexShader);
+    GLuint fs = compileShader(GL_FRAGMENT_SHADER, lutFragmentShader);
+    if (!vs || !fs) {
+        if (vs) glDeleteShader(vs);
+        if (fs) glDeleteShader(fs);
+        return false;
+    }
+
+    GLuint prog = glCreateProgram();
+    glAttachShader(prog, vs);
+    glAttachShader(prog, fs);
+    glBindFragDataLocation(prog, 0, "fragColor");
+    glLinkProgram(prog);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+    GLint ok = GL_FALSE;
+    glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        char log[1024];
+        glGetProgramInfoLog(prog, sizeof(log), nullptr, log);
+        std::cerr << "LUT shader link failed: " << log << std::endl;
+        glDeleteProgram(prog);
+        return false;
+    }
+    program = prog;
+
+    glGenVertexArrays(1, &vao);
+    glGenFramebuffers(1, &framebuffer);
+
+    glGenTextures(1, &fieldTexture);
+    glBindTexture(GL_TEXTURE_2D, fieldTexture);
+    setTextureParams(GL_TEXTURE_2D);
+
+    glGenTextures(1, &targetTexture);
+    glBindTexture(GL_TEXTURE_2D, targetTexture);
+    setTextureParams(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenTextures(1, &stopTexture);
+    glBindTexture(GL_TEXTURE_1D, stopTexture);
+    setTextureParams(GL_TEXTURE_1D);
+    glBindTexture(GL_TEXTURE_1D, 0);
+
+    return true;
+}
+
+void LutRenderer::uploadField(const GribField& field) {
+    TRACE_SCOPE("lutUploadField", "upload");
+    if (!init()) return;
+    if (field.values.empty() || field.width == 0 || field.height == 0) return;
+
+    fieldData.resize(field.values.size());
+    parallelFor(0, static_cast<long>(field.values.size()), [&](long i) {
+        fieldData[i] = static_cast<float>(field.values[i]);
+    });
+    bufferMemory.set(fieldData.capacity() * sizeof(float) + stopData.capacity() * sizeof(Color));
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_2D, fieldTexture);
+    if (field.width != width || field.height != height) {
+        width = static_cast<int>(field.width);
+        height = static_cast<int>(field.height);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, width, height, 0, GL_RED, GL_FLOAT, fieldData.data());
+        glBindTexture(GL_TEXTURE_2D, targetTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        // R32F field + RGBA8 target + RGB32F stops
+        textureMemory.set(static_cast<size_t>(width) * height * 8 + stopData.size() * sizeof(Color));
+    } else {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RED, GL_FLOAT, fieldData.data());
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void LutRenderer::uploadGradient(const GribViewerSettings& settings) {
+    TRACE_SCOPE("lutUploadGradient", "upload");
+    if (!init()) return;
+
+    const Gradient& gradient = GradientRegistry::instance().gradient(settings.gradient);
+    stopCount = gradient.count;
+    stopData.resize(2 * static_cast<size_t>(stopCount));
+    for (int i = 0; i < stopCount; ++i) {
+        stopData[i] = gradient.linearStop(i);
+        stopData[stopCount + i] = gradient.stop(i);
+    }
+
+    glBindTexture(GL_TEXTURE_1D, stopTexture);
+    glTexImage1D(GL_TEXTURE_1D, 0, GL_RGB32F, 2 * stopCount, 0, GL_RGB, GL_FLOAT, stopData.data());
+    glBindTexture(GL_TEXTURE_1D, 0);
+    textureMemory.set(static_cast<size_t>(width) * height * 8 + stopData.size() * sizeof(Color));
+}
+
+bool LutRenderer::render(const GribField& field, const GribViewerSettings& settings) {
+    TRACE_SCOPE("lutRender", "render");
+    if (!available() || width == 0 || height == 0 || stopCount < 2) return false;
+
+    float colorMinValue = 0.f;
+    float colorMaxValue = 0.f;
+    if (!colorRange(field, settings, colorMinValue, colorMaxValue)) return false;
+
+    GLint prevFramebuffer = 0;
+    GLint prevProgram = 0;
+    GLint prevVao = 0;
+    GLint prevViewport[4];
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prevFramebuffer);
+    glGetIntegerv(GL_CURRENT_PROGRAM, &prevProgram);
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &prevVao);
+    glGetIntegerv(GL_VIEWPORT, prevViewport);
+    GLboolean prevBlend = glIsEnabled(GL_BLEND);
+    GLboolean prevScissor = glIsEnabled(GL_SCISSOR_TEST);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, targetTexture, 0);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    if (complete) {
+        glViewport(0, 0, width, height);
+        glDisable(GL_BLEND);
+        glDisable(GL_SCISSOR_TEST);
+        glUseProgram(program);
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, fieldTexture);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_1D, stopTexture);
+
+        const bool adjust = settings.brightness != 1.0f || settings.gamma != 1.0f ||
+                            settings.vibrancy != 1.0f || settings.hueShift != 0.0f;
+        glUniform1i(glGetUniformLocation(program, "field"), 0);
+        glUniform1i(glGetUniformLocation(program, "stops"), 1);
+        glUniform1i(glGetUniformLocation(program, "stopCount"), stopCount);
+        glUniform1i(glGetUniformLocation(program, "oldColorBug"), settings.oldColorBug);
+        glUniform1f(glGetUniformLocation(program, "minVal"), colorMinValue);
+        glUniform1f(glGetUniformLocation(program, "maxVal"), colorMaxValue);
+        glUniform1i(glGetUniformLocation(program, "discreteColors"), settings.discreteColors);
+        glUniform1f(glGetUniformLocation(program, "colorCount"), static_cast<float>(settings.colorCount));
+        glUniform1i(glGetUniformLocation(program, "sqrtScale"), settings.sqrtScale);
+        glUniform1i(glGetUniformLocation(program, "adjust"), adjust);
+        glUniform1f(glGetUniformLocation(program, "brightness"), settings.brightness);
+        glUniform1f(glGetUniformLocation(program, "gamma"), settings.gamma);
+        glUniform1f(glGetUniformLocation(program, "vibrancy"), settings.vibrancy);
+        glUniform1f(glGetUniformLocation(program, "hueShift"), settings.hueShift);
+        glUniform3f(glGetUniformLocation(program, "missingColor"), settings.missingColor.r,
+                    settings.missingColor.g, settings.missingColor.b);
+
+        glBindVertexArray(vao);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        glBindTexture(GL_TEXTURE_1D, 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    glBindVertexArray(prevVao);
+    glUseProgram(prevProgram);
+    glBindFramebuffer(GL_FRAMEBUFFER, prevFramebuffer);
+    glViewport(prevViewport[0], prevViewport[1], prevViewport[2], prevViewport[3]);
+    if (prevBlend) glEnable(GL_BLEND);
+    if (prevScissor) glEnable(GL_SCISSOR_TEST);
+    return complete;
+}
+
+void LutRenderer::readback(std::vector<unsigned char>& rgb) const {
+    rgb.resize(static_cast<size_t>(width) * height * 3);
+    if (rgb.empty()) return;
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_2D, targetTexture);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGB, GL_UNSIGNED_BYTE, rgb.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
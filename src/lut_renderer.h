@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include <GL/gl.h>
+
+#include "grib_reader.h"
+#include "settings.h"
+
+// GPU colouring backend: the field lives on the GPU as a single-channel float
+// texture and the colormap as a 1D texture of its colour stops. A fragment
+// shader runs valueToColor() per pixel (normalise -> discretise/sqrt -> stop
+// interpolation -> HCL adjustments), so range and colour changes only cost a
+// redraw and colormap changes a stop upload. Renderer::renderField stays the
+// reference: the shader works on float values where the CPU path uses
+// doubles, so the two agree to one RGB8 step per channel, except for values
+// within float precision of a jump in the colour scale: a discrete colour
+// boundary, or the top end with oldColorBug (tests/lut_backend_test.cpp
+// checks this under Mesa's llvmpipe).
+class LutRenderer {
+public:
+    LutRenderer();
+    ~LutRenderer();
+
+    bool init();
+    bool available() const { return program != 0; }
+
+    void uploadField(const GribField& field);
+    void uploadGradient(const GribViewerSettings& settings);
+    // False if nothing was drawn, e.g. for an empty custom range.
+    bool render(const GribField& field, const GribViewerSettings& settings);
+    // The last rendering as tightly packed RGB8 rows.
+    void readback(std::vector<unsigned char>& rgb) const;
+
+    GLuint texture() const { return targetTexture; }
+
+private:
+    bool initTried = false;
+    GLuint program = 0;
+    GLuint vao = 0;
+    GLuint framebuffer = 0;
+    GLuint fieldTexture = 0;
+    GLuint stopTexture = 0;
+    GLuint targetTexture = 0;
+    int width = 0;
+    int height = 0;
+    int stopCount = 0;
+    std::vector<float> fieldData;
+    std::vector<Color> stopData;
+    MemoryCharge textureMemory{MemCategory::Textures};
+    MemoryCharge bufferMemory{MemCategory::ImageBuffers};
+};
@@ -10,6 +10,8 @@
 
 // ui stuff
 #include "ui/mainWindow.h"
+#include "eccodes_warmup.h"
+#include "trace.h"
 
 
 static void glfw_error_callback(int error, const char* description) {
@@ -17,6 +19,10 @@ static void glfw_error_callback(int error, const char* description) {
 }
 
 int main(int argc, char** argv) {
+    Tracer::instance().initFromEnv();
+    // runs while the window and GL context are created
+    startEccodesWarmup();
+
     // Setup window
     glfwSetErrorCallback(glfw_error_callback);
     if (!glfwInit())
@@ -106,6 +112,8 @@ int main(int argc, char** argv) {
         showMainwindow(renderer, filename, collection, yScanDirectionA, yScanDirectionB, window, io);
     }
 
+    Tracer::instance().writeEnvTrace();
+
     // Cleanup
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
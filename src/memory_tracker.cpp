@@ -0,0 +1,60 @@
+#include "memory_tracker.h"
+
+#include <cstdlib>
+#include <unistd.h>
+
+static void raiseTo(std::atomic<int64_t>& peak, int64_t value) {
+    int64_t seen = peak.load(std::memory_order_relaxed);
+    while (value > seen && !peak.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+    }
+}
+
+MemoryTracker::MemoryTracker() {
+    // GRIBVIEWER_MEMORY_BUDGET_MB overrides the default of half the physical RAM.
+    size_t budget = size_t(4) << 30;
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long pageSize = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && pageSize > 0)
+        budget = static_cast<size_t>(pages) * static_cast<size_t>(pageSize) / 2;
+    if (const char* env = std::getenv("GRIBVIEWER_MEMORY_BUDGET_MB")) {
+        long mb = std::atol(env);
+        if (mb > 0) budget = static_cast<size_t>(mb) << 20;
+    }
+    budgetBytes.store(budget, std::memory_order_relaxed);
+}
+
+MemoryTracker& MemoryTracker::instance() {
+    static MemoryTracker tracker;
+    return tracker;
+}
+
+const char* MemoryTracker::name(MemCategory c) {
+    switch (c) {
+        case MemCategory::MessageIndex: return "Message index";
+        case MemCategory::MessageBuffers: return "Message buffers";
+        case MemCategory::FieldValues: return "Field values";
+        case MemCategory::Pyramid: return "Field pyramids";
+        case MemCategory::ImageBuffers: return "Image buffers";
+        case MemCategory::TileCache: return "Tile cache";
+        case MemCategory::Textures: return "Textures";
+        case MemCategory::GradientPreviews: return "Gradient previews";
+        case MemCategory::Count: break;
+    }
+    return "?";
+}
+
+void MemoryTracker::add(MemCategory c, int64_t delta) {
+    const int i = static_cast<int>(c);
+    int64_t now = used[i].fetch_add(delta, std::memory_order_relaxed) + delta;
+    int64_t total = totalUsed.fetch_add(delta, std::memory_order_relaxed) + delta;
+    if (delta > 0) {
+        raiseTo(peaks[i], now);
+        raiseTo(totalPeakUsed, total);
+    }
+}
+
+void MemoryTracker::resetPeaks() {
+    for (int i = 0; i < categoryCount; ++i)
+        peaks[i].store(used[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    totalPeakUsed.store(totalUsed.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// What the viewer holds, by subsystem. Owners report their sizes through
+// MemoryCharge; caches consult the global budget before growing.
+enum class MemCategory {
+    MessageIndex,      // message lists, offsets, identity index
+    MessageBuffers,    // raw messages read for decoding
+    FieldValues,       // decoded GribField::values
+    Pyramid,           // FieldPyramid levels
+    ImageBuffers,      // CPU colour buffers (imgData, scratch)
+    TileCache,         // packed RGBA tiles in TileCache
+    Textures,          // GL textures (estimated from format and size)
+    GradientPreviews,  // gradient preview atlas
+    Count
+};
+
+class MemoryTracker {
+public:
+    static constexpr int categoryCount = static_cast<int>(MemCategory::Count);
+
+    static MemoryTracker& instance();
+    static const char* name(MemCategory c);
+
+    void add(MemCategory c, int64_t delta);
+
+    int64_t current(MemCategory c) const { return used[static_cast<int>(c)].load(std::memory_order_relaxed); }
+    int64_t peak(MemCategory c) const { return peaks[static_cast<int>(c)].load(std::memory_order_relaxed); }
+    int64_t total() const { return totalUsed.load(std::memory_order_relaxed); }
+    int64_t totalPeak() const { return totalPeakUsed.load(std::memory_order_relaxed); }
+    void resetPeaks();
+
+    // Soft limit for everything tracked. Caches evict instead of growing past
+    // it; data the user is looking at is never dropped to satisfy it.
+    size_t budget() const { return budgetBytes.load(std::memory_order_relaxed); }
+    void setBudget(size_t bytes) { budgetBytes.store(bytes, std::memory_order_relaxed); }
+    bool overBudget(size_t extra = 0) const {
+        return static_cast<size_t>(std::max<int64_t>(total(), 0)) + extra > budget();
+    }
+
+private:
+    MemoryTracker();
+
+    std::atomic<int64_t> used[categoryCount] = {};
+    std::atomic<int64_t> peaks[categoryCount] = {};
+    std::atomic<int64_t> totalUsed{0};
+    std::atomic<int64_t> totalPeakUsed{0};
+    std::atomic<size_t> budgetBytes{0};
+};
+
+// Bytes one object holds in one category, released when it goes away.
+// Copies charge again (they hold their own copy of the data).
+class MemoryCharge {
+public:
+    explicit MemoryCharge(MemCategory category) : category(category) {}
+    MemoryCharge(const MemoryCharge& o) : category(o.category) { set(o.charged); }
+    MemoryCharge(MemoryCharge&& o) noexcept : category(o.category), charged(o.charged) { o.charged = 0; }
+    MemoryCharge& operator=(const MemoryCharge& o) {
+        if (this != &o) set(o.charged);
+        return *this;
+    }
+    MemoryCharge& operator=(MemoryCharge&& o) noexcept {
+        if (this != &o) {
+            set(0);
+            charged = o.charged;
+            o.charged = 0;
+        }
+        return *this;
+    }
+    ~MemoryCharge() { set(0); }
+
+    void set(size_t bytes) {
+        if (bytes == charged) return;
+        MemoryTracker::instance().add(category, static_cast<int64_t>(bytes) - static_cast<int64_t>(charged));
+        charged = bytes;
+    }
+    size_t bytes() const { return charged; }
+
+private:
+    MemCategory category;
+    size_t charged = 0;
+};
@@ -1,10 +1,10 @@
 #pragma once
 
-#include <vector>
-#include <string>
+#include <cstddef>
 
 #include "gradient.h"
 
-extern std::vector<Gradient> mpl_gradients;
+extern const Gradient mpl_gradients[];
+extern const size_t mpl_gradient_count;
 
-extern const std::vector<std::string> mpl_gradient_names;
+extern const char* const mpl_gradient_names[];
@@ -0,0 +1,324 @@
+#include "png_encoder.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <zlib.h>
+
+#include "task_scheduler.h"
+#include "trace.h"
+
+namespace {
+
+constexpr size_t windowSize = 32768;
+// uncompressed bytes per stripe; pigz uses 128 KiB blocks too
+constexpr size_t stripeBytes = 128 * 1024;
+
+void putBE32(unsigned char* p, uint32_t v) {
+    p[0] = static_cast<unsigned char>(v >> 24);
+    p[1] = static_cast<unsigned char>(v >> 16);
+    p[2] = static_cast<unsigned char>(v >> 8);
+    p[3] = static_cast<unsigned char>(v);
+}
+
+int zlibLevel(PngLevel level) {
+    switch (level) {
+        case PngLevel::Fastest: return 1;
+        case PngLevel::Fast: return 3;
+        case PngLevel::Default: return 6;
+        case PngLevel::Smallest: return 9;
+    }
+    return 6;
+}
+
+int zlibStrategy(PngLevel level, bool palette) {
+    if (level == PngLevel::Fastest) return Z_RLE;
+    // filtered colour rows are mostly small residuals; indices are not
+    return palette ? Z_DEFAULT_STRATEGY : Z_FILTERED;
+}
+
+// Two-byte zlib header for a 32 KiB window, FLEVEL from the level.
+void zlibHeader(PngLevel level, unsigned char* out) {
+    const unsigned cmf = 0x78;
+    unsigned flg = static_cast<unsigned>(level) << 6;
+    flg += 31 - (cmf * 256 + flg) % 31;
+    out[0] = static_cast<unsigned char>(cmf);
+    out[1] = static_cast<unsigned char>(flg);
+}
+
+int paeth(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) return a;
+    return pb <= pc ? b : c;
+}
+
+// Residual of filter `type` at byte i.
+inline unsigned char residual(int type, const unsigned char* row, const unsigned char* prev,
+                              size_t i, int bpp) {
+    const int a = i >= static_cast<size_t>(bpp) ? row[i - bpp] : 0;
+    const int b = prev ? prev[i] : 0;
+    const int c = prev && i >= static_cast<size_t>(bpp) ? prev[i - bpp] : 0;
+    int pred = 0;
+    switch (type) {
+        case 1: pred = a; break;
+        case 2: pred = b; break;
+        case 3: pred = (a + b) / 2; break;
+        case 4: pred = paeth(a, b, c); break;
+    }
+    return static_cast<unsigned char>(row[i] - pred);
+}
+
+template <int Type>
+long filterCost(const unsigned char* row, const unsigned char* prev, size_t rowBytes, int bpp) {
+    long cost = 0;
+    for (size_t i = 0; i < rowBytes; ++i)
+        cost += std::abs(static_cast<signed char>(residual(Type, row, prev, i, bpp)));
+    return cost;
+}
+
+// Raw deflate of [data, data + size) primed with `dict`; appends to `out`.
+bool deflateStripe(const unsigned char* dict, size_t dictSize, const unsigned char* data,
+                   size_t size, bool last, PngLevel level, bool palette,
+                   std::vector<unsigned char>& out) {
+    z_stream z{};
+    if (deflateInit2(&z, zlibLevel(level), Z_DEFLATED, -15, 9,
+                     zlibStrategy(level, palette)) != Z_OK)
+        return false;
+    if (dictSize > 0)
+        deflateSetDictionary(&z, dict, static_cast<uInt>(dictSize));
+
+    const size_t start = out.size();
+    // + room for the sync flush marker
+    out.resize(start + deflateBound(&z, static_cast<uLong>(size)) + 16);
+    z.next_in = const_cast<unsigned char*>(data);
+    z.avail_in = static_cast<uInt>(size);
+    z.next_out = out.data() + start;
+    z.avail_out = static_cast<uInt>(out.size() - start);
+    // a sync flush ends the stripe on a byte boundary so the next one can follow
+    const int ret = deflate(&z, last ? Z_FINISH : Z_SYNC_FLUSH);
+    const bool ok = last ? ret == Z_STREAM_END : ret == Z_OK && z.avail_in == 0;
+    out.resize(out.size() - z.avail_out);
+    deflateEnd(&z);
+    return ok;
+}
+
+} // namespace
+
+bool pngLevelFromName(const std::string& name, PngLevel& level) {
+    std::string n = name;
+    std::transform(n.begin(), n.end(), n.begin(), ::tolower);
+    if (n == "fastest") level = PngLevel::Fastest;
+    else if (n == "fast") level = PngLevel::Fast;
+    else if (n == "default") level = PngLevel::Default;
+    else if (n == "smallest") level = PngLevel::Smallest;
+    else return false;
+    return true;
+}
+
+void pngFilterRow(const unsigned char* row, const unsigned char* prev, size_t rowBytes,
+                  int bpp, PngLevel level, bool palette, unsigned char* out) {
+    int type;
+    if (palette) {
+        type = 0;  // indices do not predict each other
+    } else if (level == PngLevel::Fastest) {
+        type = 1;
+    } else {
+        // smallest sum of absolute residuals, as libpng and stb_image_write do
+        const long costs[5] = {
+            filterCost<0>(row, prev, rowBytes, bpp), filterCost<1>(row, prev, rowBytes, bpp),
+            filterCost<2>(row, prev, rowBytes, bpp), filterCost<3>(row, prev, rowBytes, bpp),
+            filterCost<4>(row, prev, rowBytes, bpp)};
+        type = static_cast<int>(std::min_element(costs, costs + 5) - costs);
+    }
+    out[0] = static_cast<unsigned char>(type);
+    for (size_t i = 0; i < rowBytes; ++i) out[i + 1] = residual(type, row, prev, i, bpp);
+}
+
+bool pngDeflate(const unsigned char* data, size_t size, PngLevel level, bool palette,
+                std::vector<unsigned char>& out) {
+    out.resize(2);
+    zlibHeader(level, out.data());
+    if (!deflateStripe(nullptr, 0, data, size, true, level, palette, out)) return false;
+    const size_t pos = out.size();
+    out.resize(pos + 4);
+    putBE32(out.data() + pos, static_cast<uint32_t>(adler32(1, data, static_cast<uInt>(size))));
+    return true;
+}
+
+void appendPngChunk(std::vector<unsigned char>& out, const char* type,
+                    const std::vector<unsigned char>& data) {
+    const size_t pos = out.size();
+    out.resize(pos + 8);
+    putBE32(out.data() + pos, static_cast<uint32_t>(data.size()));
+    std::memcpy(out.data() + pos + 4, type, 4);
+    out.insert(out.end(), data.begin(), data.end());
+    const uLong crc = crc32(0, out.data() + pos + 4, static_cast<uInt>(data.size() + 4));
+    out.resize(out.size() + 4);
+    putBE32(out.data() + out.size() - 4, static_cast<uint32_t>(crc));
+}
+
+PngEncoder::PngEncoder(Sink sink, int width, int height, PngColorType type, PngLevel level)
+    : sink(std::move(sink)), width(width), height(height), type(type), level(level) {
+    channels = type == PngColorType::Rgba ? 4 : type == PngColorType::Rgb ? 3 : 1;
+    rowBytes = static_cast<size_t>(std::max(width, 0)) * channels;
+}
+
+bool PngEncoder::writeChunk(const char* chunkType, const unsigned char* data, size_t size) {
+    unsigned char head[8];
+    putBE32(head, static_cast<uint32_t>(size));
+    std::memcpy(head + 4, chunkType, 4);
+    uLong crc = crc32(0, head + 4, 4);
+    if (size > 0) crc = crc32(crc, data, static_cast<uInt>(size));
+    unsigned char tail[4];
+    putBE32(tail, static_cast<uint32_t>(crc));
+    failed = failed || !sink(head, 8) || (size > 0 && !sink(data, size)) || !sink(tail, 4);
+    return !failed;
+}
+
+bool PngEncoder::writeHeader() {
+    headerWritten = true;
+    if (width <= 0 || height <= 0 ||
+        (type == PngColorType::Palette && (palette.empty() || palette.size() > 768))) {
+        failed = true;
+        return false;
+    }
+    static const unsigned char signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    failed = !sink(signature, 8);
+    unsigned char ihdr[13];
+    putBE32(ihdr, width);
+    putBE32(ihdr + 4, height);
+    ihdr[8] = 8;  // bits per sample
+    ihdr[9] = static_cast<unsigned char>(type);
+    ihdr[10] = ihdr[11] = ihdr[12] = 0;
+    writeChunk("IHDR", ihdr, sizeof(ihdr));
+    if (type == PngColorType::Palette)
+        writeChunk("PLTE", palette.data(), palette.size() / 3 * 3);
+    return !failed;
+}
+
+bool PngEncoder::writeRows(int rows, const RowSource& source) {
+    TRACE_SCOPE("pngRows", "export");
+    if (!headerWritten) writeHeader();
+    rows = std::min(rows, height - rowsDone);
+    if (failed || rows <= 0) return !failed;
+
+    const int bpp = channels;
+    const bool indexed = type == PngColorType::Palette;
+    const size_t filteredRow = rowBytes + 1;
+    const long rowsPerStripe = static_cast<long>(std::max<size_t>(1, stripeBytes / filteredRow));
+
+    // raw rows with the previous one in front, so every row has its `prev`
+    std::vector<unsigned char> raw(rowBytes * (rows + 1));
+    std::vector<unsigned char> filtered(filteredRow * rows);
+    if (rowsDone > 0) std::copy(lastRow.begin(), lastRow.end(), raw.begin());
+    const int first = rowsDone;
+    parallelFor(0, rows, [&](long r) {
+        source(first + static_cast<int>(r), raw.data() + rowBytes * (r + 1));
+    }, TaskScheduler::currentPriority(), rowsPerStripe);
+    parallelFor(0, rows, [&](long r) {
+        const unsigned char* prev = first + r > 0 ? raw.data() + rowBytes * r : nullptr;
+        pngFilterRow(raw.data() + rowBytes * (r + 1), prev, rowBytes, bpp, level, indexed,
+                     filtered.data() + filteredRow * r);
+    }, TaskScheduler::currentPriority(), rowsPerStripe);
+
+    // each stripe is primed with the 32 KiB before it, which for the first
+    // stripes of a batch reaches back into the previous batch
+    std::vector<unsigned char> history = dictionary;
+    history.insert(history.end(), filtered.begin(),
+                   filtered.begin() + std::min(filtered.size(), windowSize));
+
+    const bool lastBatch = rowsDone + rows == height;
+    const long stripeCount = (rows + rowsPerStripe - 1) / rowsPerStripe;
+    std::vector<std::vector<unsigned char>> out(stripeCount);
+    std::vector<uLong> adlers(stripeCount);
+    std::vector<char> ok(stripeCount, 0);
+    parallelFor(0, stripeCount, [&](long s) {
+        const size_t begin = filteredRow * (s * rowsPerStripe);
+        const size_t end = std::min(filtered.size(), begin + filteredRow * rowsPerStripe);
+        const unsigned char* dict;
+        size_t dictSize;
+        if (begin >= windowSize) {
+            dict = filtered.data() + begin - windowSize;
+            dictSize = windowSize;
+        } else {
+            // history = dictionary + filtered[0, windowSize)
+            const size_t histEnd = dictionary.size() + begin;
+            dictSize = std::min(histEnd, windowSize);
+            dict = history.data() + histEnd - dictSize;
+        }
+        const bool last = lastBatch && s == stripeCount - 1;
+        std::vector<unsigned char>& bytes = out[s];
+        // the first chunk carries the zlib header, the last one the checksum
+        if (first == 0 && s == 0) {
+            bytes.resize(2);
+            zlibHeader(level, bytes.data());
+        }
+        ok[s] = deflateStripe(dict, dictSize, filtered.data() + begin, end - begin, last,
+                              level, indexed, bytes);
+        adlers[s] = adler32(1, filtered.data() + begin, static_cast<uInt>(end - begin));
+    }, TaskScheduler::currentPriority(), 1);
+
+    for (long s = 0; s < stripeCount && !failed; ++s) {
+        if (!ok[s]) {
+            failed = true;
+            break;
+        }
+        const size_t begin = filteredRow * (s * rowsPerStripe);
+        const size_t len = std::min(filtered.size(), begin + filteredRow * rowsPerStripe) - begin;
+        adler = static_cast<uint32_t>(adler32_combine(adler, adlers[s], static_cast<z_off_t>(len)));
+        std::vector<unsigned char>& bytes = out[s];
+        if (lastBatch && s == stripeCount - 1) {
+            bytes.resize(bytes.size() + 4);
+            putBE32(bytes.data() + bytes.size() - 4, adler);
+        }
+        writeChunk("IDAT", bytes.data(), bytes.size());
+    }
+
+    lastRow.assign(raw.end() - rowBytes, raw.end());
+    if (filtered.size() >= windowSize) {
+        dictionary.assign(filtered.end() - windowSize, filtered.end());
+    } else {
+        dictionary.insert(dictionary.end(), filtered.begin(), filtered.end());
+        if (dictionary.size() > windowSize)
+            dictionary.erase(dictionary.begin(), dictionary.end() - windowSize);
+    }
+    rowsDone += rows;
+    return !failed;
+}
+
+bool PngEncoder::finish() {
+    if (!headerWritten) writeHeader();
+    if (rowsDone != height) failed = true;
+    if (!failed) writeChunk("IEND", nullptr, 0);
+    return !failed;
+}
+
+bool writePng(const std::string& filename, int width, int height, PngColorType type,
+              const PngEncoder::RowSource& source, PngLevel level,
+              const std::vector<unsigned char>& palette) {
+    FILE* f = std::fopen(filename.c_str(), "wb");
+    if (!f) return false;
+    PngEncoder png([f](const unsigned char* data, size_t size) {
+        return std::fwrite(data, 1, size, f) == size;
+    }, width, height, type, level);
+    png.setPalette(palette);
+    bool ok = png.writeRows(height, source) && png.finish();
+    ok = std::fclose(f) == 0 && ok;
+    if (!ok) std::remove(filename.c_str());
+    return ok;
+}
+
+bool writePng(std::vector<unsigned char>& out, int width, int height, PngColorType type,
+              const PngEncoder::RowSource& source, PngLevel level,
+              const std::vector<unsigned char>& palette) {
+    out.clear();
+    PngEncoder png([&out](const unsigned char* data, size_t size) {
+        out.insert(out.end(), data, data + size);
+        return true;
+    }, width, height, type, level);
+    png.setPalette(palette);
+    return png.writeRows(height, source) && png.finish();
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Speed/size trade-off. Fastest uses a fixed filter and run-length matching;
+// the others choose a filter per row and deflate at zlib level 3, 6 and 9.
+enum class PngLevel {
+    Fastest,
+    Fast,
+    Default,
+    Smallest
+};
+
+enum class PngColorType {
+    Rgb = 2,
+    Palette = 3,  // one index byte per pixel, see PngEncoder::setPalette
+    Rgba = 6
+};
+
+bool pngLevelFromName(const std::string& name, PngLevel& level);
+
+// Streaming PNG writer. Rows are handed over in order, in one or more
+// batches; each batch is cut into stripes that are filtered and deflated in
+// parallel and written as one IDAT chunk each. As in pigz, every stripe is
+// primed with the 32 KiB before it, so the stripes form a single zlib stream
+// that compresses about as well as a serial one.
+class PngEncoder {
+public:
+    // Receives the file contents in order; returns false to abort.
+    using Sink = std::function<bool(const unsigned char* data, size_t size)>;
+    // Fills `out` with row y (width * channels bytes). Called from several
+    // threads at once, for different rows.
+    using RowSource = std::function<void(int y, unsigned char* out)>;
+
+    PngEncoder(Sink sink, int width, int height, PngColorType type,
+               PngLevel level = PngLevel::Default);
+
+    // Up to 256 RGB triplets; required for PngColorType::Palette.
+    void setPalette(std::vector<unsigned char> rgb) { palette = std::move(rgb); }
+
+    // Encodes rows [rowsWritten(), rowsWritten() + rows).
+    bool writeRows(int rows, const RowSource& source);
+    // False if rows are missing or anything failed to write.
+    bool finish();
+
+    int rowsWritten() const { return rowsDone; }
+
+private:
+    bool writeHeader();
+    bool writeChunk(const char* type, const unsigned char* data, size_t size);
+
+    Sink sink;
+    int width;
+    int height;
+    PngColorType type;
+    PngLevel level;
+    int channels;
+    size_t rowBytes;
+    std::vector<unsigned char> palette;
+
+    bool headerWritten = false;
+    bool failed = false;
+    int rowsDone = 0;
+    uint32_t adler = 1;
+    std::vector<unsigned char> lastRow;     // raw, the previous row for filtering
+    std::vector<unsigned char> dictionary;  // last 32 KiB of filtered data
+};
+
+// Whole image to a file or a memory buffer.
+bool writePng(const std::string& filename, int width, int height, PngColorType type,
+              const PngEncoder::RowSource& source, PngLevel level = PngLevel::Default,
+              const std::vector<unsigned char>& palette = {});
+bool writePng(std::vector<unsigned char>& out, int width, int height, PngColorType type,
+              const PngEncoder::RowSource& source, PngLevel level = PngLevel::Default,
+              const std::vector<unsigned char>& palette = {});
+
+// Building blocks for other PNG-based formats (APNG frames).
+
+// Filter byte plus filtered bytes of one scanline into `out` (rowBytes + 1).
+// `prev` is the previous raw row, or null for the first.
+void pngFilterRow(const unsigned char* row, const unsigned char* prev, size_t rowBytes,
+                  int bytesPerPixel, PngLevel level, bool palette, unsigned char* out);
+// Serial zlib stream of filtered scanlines.
+bool pngDeflate(const unsigned char* data, size_t size, PngLevel level, bool palette,
+                std::vector<unsigned char>& out);
+// Appends length, type, `data` and CRC.
+void appendPngChunk(std::vector<unsigned char>& out, const char* type,
+                    const std::vector<unsigned char>& data);
@@ -0,0 +1,92 @@
+#include "progressive_renderer.h"
+
+#include <algorithm>
+#include <imgui.h>
+
+#include "renderer.h"
+#include "trace.h"
+
+ProgressiveRenderer::ProgressiveRenderer() {
+}
+
+ProgressiveRenderer::~ProgressiveRenderer() {
+}
+
+void ProgressiveRenderer::start(Renderer& renderer, const GribField& f, GribViewerSettings& s,
+                                GLuint tex, std::vector<Color>& img) {
+    field = &f;
+    settings = &s;
+    imgData = &img;
+    texture = tex;
+    width = static_cast<int>(f.width);
+    height = static_cast<int>(f.height);
+    rowsDone = 0;
+    active = img.size() == static_cast<size_t>(width) * height;
+    if (!active) return;
+
+    // smallest pyramid level that fits the preview size
+    int level = 0;
+    for (int k = 1; k <= f.pyramid.levelCount(); ++k) {
+        level = k;
+        const PyramidLevel* lvl = f.pyramid.level(k);
+        if (lvl->width <= previewMaxSize && lvl->height <= previewMaxSize) break;
+    }
+    const PyramidLevel* lvl = f.pyramid.level(level);
+    if (!lvl) return;
+
+    renderer.renderLevel(f, level, s, previewData);
+    if (previewTexture == 0 || previewWidth != lvl->width || previewHeight != lvl->height) {
+        Renderer::deleteTexture(previewTexture);
+        previewWidth = static_cast<int>(lvl->width);
+        previewHeight = static_cast<int>(lvl->height);
+        previewTexture = renderer.createTexture(previewWidth, previewHeight);
+    }
+    renderer.updateTexture(previewTexture, previewWidth, previewHeight, previewData);
+}
+
+bool ProgressiveRenderer::step(Renderer& renderer) {
+    TRACE_SCOPE("progressiveStep", "render");
+    if (!active) return false;
+
+    using clock = std::chrono::steady_clock;
+    const auto begin = clock::now();
+    const auto deadline = begin + std::chrono::duration<double, std::milli>(budgetMs);
+    while (rowsDone < height) {
+        const int rows = std::min(bandRows, height - rowsDone);
+        const auto bandStart = clock::now();
+        Color* out = imgData->data() + static_cast<size_t>(rowsDone) * width;
+        renderer.renderRegion(*field, 0, rowsDone, width, rows, *settings, out);
+        renderer.updateTextureRows(texture, width, rowsDone, rows, out);
+        rowsDone += rows;
+
+        // size the next band so that it takes roughly a quarter of the budget
+        const double bandMs = std::chrono::duration<double, std::milli>(clock::now() - bandStart).count();
+        if (bandMs > 0.0)
+            bandRows = std::clamp(static_cast<int>(rows * (budgetMs * 0.25) / bandMs), 1, 4096);
+        if (clock::now() >= deadline) break;
+    }
+    if (rowsDone < height) return false;
+    active = false;
+    return true;
+}
+
+void ProgressiveRenderer::draw(const GribField& f, float zoom) const {
+    const ImVec2 size(f.width * zoom, f.height * zoom);
+    if (previewTexture == 0) {
+        ImGui::Dummy(size);
+        return;
+    }
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    ImGui::Image((ImTextureID)(intptr_t)previewTexture, size, fieldUv1(f), fieldUv2(f));
+
+    if (rowsDone == 0) return;
+    // finished rows [0, rowsDone) of the full-resolution texture on top
+    const float frac = static_cast<float>(rowsDone) / height;
+    const bool flipped = f.jScansPositively;
+    const float top = flipped ? size.y * (1.f - frac) : 0.f;
+    ImVec2 pMin(origin.x, origin.y + top);
+    ImVec2 pMax(origin.x + size.x, pMin.y + size.y * frac);
+    ImVec2 uvMin = flipped ? ImVec2(0, frac) : ImVec2(0, 0);
+    ImVec2 uvMax = flipped ? ImVec2(1, 0) : ImVec2(1, frac);
+    ImGui::GetWindowDrawList()->AddImage((ImTextureID)(intptr_t)texture, pMin, pMax, uvMin, uvMax);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+#include <GL/gl.h>
+
+#include "grib_reader.h"
+#include "settings.h"
+
+class Renderer;
+
+// Interruptible full-resolution render for grids that take longer than a
+// frame. start() shows a coarse preview from a small pyramid level at once;
+// step() then colours row bands into the image until the per-frame budget is
+// spent and uploads each finished band, so the picture sharpens over a few
+// frames while the UI keeps running.
+class ProgressiveRenderer {
+public:
+    // below this many pixels a synchronous renderField is cheaper
+    static constexpr long minPixels = 1L << 20;
+    static constexpr int previewMaxSize = 512;
+    double budgetMs = 4.0;
+
+    ProgressiveRenderer();
+    ~ProgressiveRenderer();
+
+    static bool worthwhile(const GribField& field) {
+        return field.width * field.height >= minPixels;
+    }
+
+    // imgData must hold field.width * field.height pixels and stay alive
+    // (like field and settings) until the job finishes or is cancelled.
+    void start(Renderer& renderer, const GribField& field, GribViewerSettings& settings,
+               GLuint texture, std::vector<Color>& imgData);
+    // Returns true on the frame the image becomes complete.
+    bool step(Renderer& renderer);
+    void cancel() { active = false; }
+
+    bool running() const { return active; }
+    float progress() const { return height > 0 ? static_cast<float>(rowsDone) / height : 1.f; }
+
+    // Draws preview plus finished bands at the field's display size.
+    void draw(const GribField& field, float zoom) const;
+
+private:
+    bool active = false;
+    const GribField* field = nullptr;
+    GribViewerSettings* settings = nullptr;
+    std::vector<Color>* imgData = nullptr;
+    GLuint texture = 0;
+    int width = 0;
+    int height = 0;
+    int rowsDone = 0;
+    int bandRows = 16;
+
+    GLuint previewTexture = 0;
+    int previewWidth = 0;
+    int previewHeight = 0;
+    std::vector<Color> previewData;
+};
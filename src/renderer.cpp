@@ -1,7 +1,13 @@
 #include "renderer.h"
 
-#include "color_adjust.h"
+#include <unordered_map>
 
+#include "field_render.h"
+#include "memory_tracker.h"
+#include "trace.h"
+
+// createTexture sizes, for the Textures memory category
+static std::unordered_map<GLuint, size_t> textureBytes;
 
 Renderer::Renderer() {
 }
@@ -38,14 +44,30 @@ GLuint Renderer::createTexture(const int displayWidth, const int displayHeight)
 
     glBindTexture(GL_TEXTURE_2D, 0);
 
+    const size_t bytes = static_cast<size_t>(displayWidth) * displayHeight * sizeof(Color);
+    textureBytes[tex] = bytes;
+    MemoryTracker::instance().add(MemCategory::Textures, static_cast<int64_t>(bytes));
+
     return tex;
 }
 
+void Renderer::deleteTexture(GLuint& texture) {
+    if (texture == 0) return;
+    auto it = textureBytes.find(texture);
+    if (it != textureBytes.end()) {
+        MemoryTracker::instance().add(MemCategory::Textures, -static_cast<int64_t>(it->second));
+        textureBytes.erase(it);
+    }
+    glDeleteTextures(1, &texture);
+    texture = 0;
+}
+
 void Renderer::updateTexture(GLuint texture,
                              int width,
                              int height,
                              const std::vector<Color>& data)
 {
+    TRACE_SCOPE("updateTexture", "upload");
     if (data.size() != static_cast<size_t>(width * height))
         return; // or assert
 
@@ -65,78 +87,67 @@ void Renderer::updateTexture(GLuint texture,
     glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-Color valueToColor(double value, double min_val, double max_val, const Gradient& gradient,
-    GribViewerSettings& settings) {
-    // Normalize value to 0-1
-    double normalized = (value - min_val) / (max_val - min_val);
-    normalized = std::clamp(normalized, 0.0, 1.0);
-    if (settings.discreteColors) {
-        normalized = std::floor(normalized * settings.colorCount) / (settings.colorCount - 1.);
-    }
-    if (settings.sqrtScale) normalized = sqrt(normalized);
-    
-    // Color c = value >= -999999999. ? Color(.7f, 0.f, 0.f) : gradient.get_color(static_cast<float>(normalized));
-    Color c = gradient.get_color(static_cast<float>(normalized), settings.oldColorBug);
-    return applyHclAdjustments(c, settings.brightness, settings.gamma,
-                               settings.vibrancy, settings.hueShift);
+void Renderer::updateTexture(GLuint texture,
+                             int width,
+                             int height,
+                             const std::vector<uint32_t>& rgba)
+{
+    TRACE_SCOPE("updateTexture", "upload");
+    if (rgba.size() != static_cast<size_t>(width * height))
+        return;
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
 }
 
+void Renderer::updateTextureRows(GLuint texture, int width, int y0, int rows, const Color* data) {
+    TRACE_SCOPE("updateTextureRows", "upload");
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y0, width, rows, GL_RGB, GL_FLOAT, data);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+bool Renderer::uploadFromCache(GLuint texture, const TileCacheKey& key) {
+    const CachedTile* tile = tileCache.find(key);
+    if (!tile) return false;
+    updateTexture(texture, tile->width, tile->height, tile->rgba);
+    return true;
+}
 
 void Renderer::renderField(const GribField& field, int displayWidth, int displayHeight, 
     GribViewerSettings& settings, std::vector<Color>& imgData) {
-    if (field.values.empty() || field.width == 0 || field.height == 0) {
-        ImGui::Text("No data to display");
-        return;
-    }
-    
-    float colorMinValue = 0.f;
-    float colorMaxValue = 0.f;
-    if (settings.useCustomMinMax || settings.symmetricAroundZero) {
-        if (settings.minVal >= settings.maxVal) {
+    switch (colorizeField(field, displayWidth, displayHeight, settings, imgData)) {
+        case ColorizeStatus::NoData:
+            ImGui::Text("No data to display");
+            break;
+        case ColorizeStatus::InvalidRange:
             ImGui::Text("Invalid custom min/max values");
-            return;
-        } else {
-            colorMinValue = settings.minVal;
-            colorMaxValue = settings.maxVal;
-        }
-    }
-    else {
-        colorMinValue = static_cast<float>(field.min_value);
-        colorMaxValue = static_cast<float>(field.max_value);
-    }
-    // Fill each pixel
-    # pragma omp parallel for
-    for (int y = 0; y < displayHeight; ++y) {
-        for (int x = 0; x < displayWidth; ++x) {
-            
-            int fieldPosX = x * field.width / displayWidth;
-            int fieldPosY = y * field.height / displayHeight;
-            int idxField = field.width * fieldPosY + fieldPosX;
-            int idxImg = y * displayWidth + x;
-
-            double value = field.values[idxField];
-            imgData[idxImg] = valueToColor(value, colorMinValue, colorMaxValue, settings.gradient,
-                settings);
-            
-        }
+            break;
+        case ColorizeStatus::Ok:
+            break;
     }
 }
 
+void Renderer::renderRegion(const GribField& field, int x0, int y0, int w, int h,
+    GribViewerSettings& settings, std::vector<Color>& imgData) {
+    if (imgData.size() < static_cast<size_t>(w) * h)
+        return;
+    colorizeRegion(field, x0, y0, w, h, settings, imgData.data());
+}
+
+void Renderer::renderRegion(const GribField& field, int x0, int y0, int w, int h,
+    GribViewerSettings& settings, Color* imgData) {
+    colorizeRegion(field, x0, y0, w, h, settings, imgData);
+}
+
+void Renderer::renderLevel(const GribField& field, int level, GribViewerSettings& settings,
+    std::vector<Color>& imgData) {
+    colorizeLevel(field, level, settings, imgData);
+}
+
 void Renderer::updateCbar(GLuint texture, const int width, const int height, std::vector<Color>& data,
     GribViewerSettings& settings) {
-    
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            uint idx = y * width + x;
-            float cidx = float(x) / float(width - 1);
-            cidx = std::clamp(cidx, 0.f, 1.f);
-            if (settings.discreteColors) {
-                cidx = std::floor(cidx * settings.colorCount) / (settings.colorCount - 1.);
-            }
-            if (settings.sqrtScale) cidx = sqrt(cidx);
-            Color c = settings.gradient.get_color(cidx, settings.oldColorBug);
-            data[idx] = applyHclAdjustments(c, settings.brightness, settings.gamma,
-                                            settings.vibrancy, settings.hueShift);
-        }
-    }
+    colorizeColorbar(width, height, settings, data);
 }
@@ -7,19 +7,46 @@
 #include <iostream>
 #include <GL/gl.h>
 
+#include "field_render.h"
 #include "grib_reader.h"
+#include "lut_renderer.h"
+#include "progressive_renderer.h"
+#include "tile_cache.h"
+#include "tiled_renderer.h"
 #include "mpl_gradients.h"
 #include "settings.h"
 
+// Texture coordinates that draw a field north-up. Rows are stored in scan
+// order, so a field scanning south to north has to be flipped.
+inline ImVec2 fieldUv1(const GribField& field) {
+    return field.jScansPositively ? ImVec2(0, 1) : ImVec2(0, 0);
+}
+
+inline ImVec2 fieldUv2(const GribField& field) {
+    return field.jScansPositively ? ImVec2(1, 0) : ImVec2(1, 1);
+}
+
 class Renderer {
 public:
     Renderer();
     ~Renderer();
     GLuint createTexture(const int displayWidth, const int displayHeight);
+    // Deletes a texture made by createTexture and releases its memory charge.
+    static void deleteTexture(GLuint& texture);
     void updateTexture(GLuint texture,
                              int width,
                              int height,
                              const std::vector<Color>& data);
+    void updateTexture(GLuint texture,
+                             int width,
+                             int height,
+                             const std::vector<uint32_t>& rgba);
+
+    // Uploads `rows` full-width rows starting at row y0.
+    void updateTextureRows(GLuint texture, int width, int y0, int rows, const Color* data);
+
+    // Uploads the cached rendering for `key` into `texture`; false on a miss.
+    bool uploadFromCache(GLuint texture, const TileCacheKey& key);
     
 void updateCbar(GLuint texture, const int width, const int height, std::vector<Color>& data,
     GribViewerSettings& settings);
@@ -27,4 +54,23 @@ void updateCbar(GLuint texture, const int width, const int height, std::vector<C
     void renderField(const GribField& field, int displayWidth, int displayHeight, 
     GribViewerSettings& settings, std::vector<Color>& imgData);
 
+    // Colours the field rectangle [x0, x0 + w) x [y0, y0 + h) at full resolution
+    // into a w x h buffer, with the same colour path as renderField.
+    void renderRegion(const GribField& field, int x0, int y0, int w, int h,
+    GribViewerSettings& settings, std::vector<Color>& imgData);
+    void renderRegion(const GribField& field, int x0, int y0, int w, int h,
+    GribViewerSettings& settings, Color* out);
+
+    // Colours pyramid level `level` of the field (see FieldPyramid) into a
+    // level.width x level.height buffer.
+    void renderLevel(const GribField& field, int level, GribViewerSettings& settings,
+    std::vector<Color>& imgData);
+
+    // alternative backends, selected through GribViewerSettings::backend
+    LutRenderer lutRenderer;
+    TiledRenderer tiledRenderer;
+    ProgressiveRenderer progressiveRenderer;
+
+    // rendered images/tiles of recently shown field + settings combinations
+    TileCache tileCache;
 };
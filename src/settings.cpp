@@ -1,9 +1,16 @@
 #include "settings.h"
 
+#include <cstring>
+
 bool operator==(const GribViewerSettings& lhs, const GribViewerSettings& rhs) {
 
     return (
+        lhs.backend == rhs.backend &&
+        lhs.gradient == rhs.gradient &&
         lhs.displayZoomFactor == rhs.displayZoomFactor &&
+        lhs.progressiveRendering == rhs.progressiveRendering &&
+        lhs.zoomOutLevel == rhs.zoomOutLevel &&
+        lhs.zoomOutStat == rhs.zoomOutStat &&
         lhs.minVal == rhs.minVal &&
         lhs.maxVal == rhs.maxVal &&
         lhs.discreteColors == rhs.discreteColors &&
@@ -15,7 +22,10 @@ bool operator==(const GribViewerSettings& lhs, const GribViewerSettings& rhs) {
         lhs.brightness == rhs.brightness &&
         lhs.gamma == rhs.gamma &&
         lhs.vibrancy == rhs.vibrancy &&
-        lhs.hueShift == rhs.hueShift
+        lhs.hueShift == rhs.hueShift &&
+        lhs.missingColor.r == rhs.missingColor.r &&
+        lhs.missingColor.g == rhs.missingColor.g &&
+        lhs.missingColor.b == rhs.missingColor.b
     );
 }
 
@@ -25,6 +35,7 @@ bool operator!=(const GribViewerSettings& lhs, const GribViewerSettings& rhs) {
 
 bool cmapUpgradeNeeded(const GribViewerSettings& oldSettings, const GribViewerSettings& newSettings) {
     return (
+        oldSettings.gradient != newSettings.gradient ||
         oldSettings.sqrtScale != newSettings.sqrtScale ||
         oldSettings.discreteColors != newSettings.discreteColors ||
         oldSettings.colorCount != newSettings.colorCount ||
@@ -34,4 +45,38 @@ bool cmapUpgradeNeeded(const GribViewerSettings& oldSettings, const GribViewerSe
         oldSettings.vibrancy != newSettings.vibrancy ||
         oldSettings.hueShift != newSettings.hueShift
     );
-}
\ No newline at end of file
+}
+
+uint64_t renderSettingsHash(const GribViewerSettings& settings) {
+    // FNV-1a over the raw bytes of the render-relevant fields
+    uint64_t h = 1469598103934665603ull;
+    auto mix = [&h](const void* data, size_t len) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < len; ++i) {
+            h ^= p[i];
+            h *= 1099511628211ull;
+        }
+    };
+    auto mixValue = [&mix](const auto& v) { mix(&v, sizeof(v)); };
+
+    const bool customRange = settings.useCustomMinMax || settings.symmetricAroundZero;
+    mixValue(customRange);
+    if (customRange) {
+        mixValue(settings.minVal);
+        mixValue(settings.maxVal);
+    }
+    mixValue(settings.discreteColors);
+    if (settings.discreteColors) mixValue(settings.colorCount);
+    mixValue(settings.sqrtScale);
+    mixValue(settings.oldColorBug);
+    mixValue(settings.brightness);
+    mixValue(settings.gamma);
+    mixValue(settings.vibrancy);
+    mixValue(settings.hueShift);
+    mixValue(settings.missingColor.r);
+    mixValue(settings.missingColor.g);
+    mixValue(settings.missingColor.b);
+    mixValue(settings.zoomOutStat);
+    mixValue(settings.gradient);
+    return h;
+}
@@ -1,11 +1,25 @@
 #pragma once
 
-#include "gradient.h"
-#include "mpl_gradients.h"
+#include <cstdint>
+
+#include "field_pyramid.h"
+#include "gradient_registry.h"
+
+enum class RenderBackend {
+    Cpu,        // renderField, the reference implementation
+    LutShader,  // LutRenderer, field texture + colormap LUT in a fragment shader
+    CpuTiled    // TiledRenderer, only the visible tiles are coloured and uploaded
+};
 
 struct GribViewerSettings {
+    RenderBackend backend = RenderBackend::Cpu;
     int displayZoomFactor = 1;
-    Gradient gradient = mpl_gradients[0];
+    // large grids are refined over several frames instead of stalling the UI
+    bool progressiveRendering = true;
+    // zoomed-out display reads pyramid level N (1/2^N resolution)
+    int zoomOutLevel = 0;
+    PyramidStat zoomOutStat = PyramidStat::Mean;
+    GradientHandle gradient = 0;
     float minVal = 0.;
     float maxVal = 1.;
     bool discreteColors = false;
@@ -20,9 +34,16 @@ struct GribViewerSettings {
     float gamma = 1.0f;
     float vibrancy = 1.0f;
     float hueShift = 0.0f;
+    // drawn where the field has no value (bitmap gaps, e.g. over land or
+    // outside a limited area)
+    Color missingColor = Color(0.5f, 0.5f, 0.5f);
 };
 
 bool operator==(const GribViewerSettings& lhs, const GribViewerSettings& rhs);
 bool operator!=(const GribViewerSettings& lhs, const GribViewerSettings& rhs);
 
+// Hash of everything that changes the colour of a pixel for a given field
+// (not display-only settings such as zoom or backend); keys the TileCache.
+uint64_t renderSettingsHash(const GribViewerSettings& settings);
+
 bool cmapUpgradeNeeded(const GribViewerSettings& oldSettings, const GribViewerSettings& newSettings);
\ No newline at end of file
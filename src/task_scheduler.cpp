@@ -0,0 +1,227 @@
+#include "task_scheduler.h"
+
+#include <cstdlib>
+
+static int requestedWorkers = -1;
+static thread_local int workerIndex = -1;
+static thread_local int taskPriority = static_cast<int>(TaskPriority::Interactive);
+
+void TaskScheduler::setWorkerCount(unsigned count) {
+    requestedWorkers = static_cast<int>(count);
+}
+
+TaskScheduler& TaskScheduler::instance() {
+    static TaskScheduler scheduler([] {
+        if (requestedWorkers >= 0) return static_cast<unsigned>(requestedWorkers);
+        if (const char* env = std::getenv("GRIBVIEWER_THREADS")) {
+            int threads = std::atoi(env);
+            if (threads > 0) return static_cast<unsigned>(threads - 1);
+        }
+        unsigned hw = std::thread::hardware_concurrency();
+        return hw > 1 ? hw - 1 : 1u;
+    }());
+    return scheduler;
+}
+
+int TaskScheduler::currentWorker() {
+    return workerIndex;
+}
+
+TaskPriority TaskScheduler::currentPriority() {
+    return static_cast<TaskPriority>(taskPriority);
+}
+
+TaskScheduler::TaskScheduler(unsigned count) {
+    // keep one worker free for interactive work whenever there is more than one
+    backgroundLimit = std::max(1, static_cast<int>(count) - 1);
+    for (unsigned i = 0; i < count; ++i)
+        workers.push_back(std::make_unique<Worker>());
+    for (unsigned i = 0; i < count; ++i)
+        workers[i]->thread = std::thread(&TaskScheduler::workerLoop, this, static_cast<int>(i));
+}
+
+TaskScheduler::~TaskScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& w : workers)
+        if (w->thread.joinable()) w->thread.join();
+}
+
+void TaskScheduler::submit(TaskPriority priority, Task task) {
+    const int p = static_cast<int>(priority);
+    if (workers.empty()) {
+        // no pool: run inline
+        task();
+        return;
+    }
+    // workers keep their own tasks local; other threads spread round-robin
+    int target = workerIndex >= 0
+        ? workerIndex
+        : static_cast<int>(nextWorker.fetch_add(1, std::memory_order_relaxed) % workers.size());
+    {
+        std::lock_guard<std::mutex> lock(workers[target]->mutex);
+        workers[target]->queues[p].push_back(std::move(task));
+    }
+    queuedCount[p].fetch_add(1, std::memory_order_relaxed);
+    notify();
+}
+
+void TaskScheduler::notify() {
+    // taking the lock orders this against a worker checking runnable() before it sleeps
+    bool waiting;
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        waiting = blockedWaiters > 0;
+    }
+    wake.notify_one();
+    // waiters take only work of their own priority, so wake all of them
+    if (waiting) waiters.notify_all();
+}
+
+void TaskScheduler::block(int lowest, const std::atomic<int>& pending) {
+    const bool limitBackground = taskPriority != static_cast<int>(TaskPriority::Background);
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    ++blockedWaiters;
+    waiters.wait(lock, [&] {
+        return pending.load(std::memory_order_acquire) == 0 || runnable(lowest, limitBackground);
+    });
+    --blockedWaiters;
+}
+
+bool TaskScheduler::take(int self, int lowest, bool limitBackground, Task& task, int& priority) {
+    const int n = static_cast<int>(workers.size());
+    for (int p = 0; p <= lowest; ++p) {
+        if (queuedCount[p].load(std::memory_order_relaxed) == 0) continue;
+        if (p == static_cast<int>(TaskPriority::Background) && limitBackground &&
+            backgroundRunning.load(std::memory_order_relaxed) >= backgroundLimit)
+            continue;
+        // own deque from the back (most recent, cache-warm), others from the front
+        if (self >= 0) {
+            Worker& w = *workers[self];
+            std::lock_guard<std::mutex> lock(w.mutex);
+            if (!w.queues[p].empty()) {
+                task = std::move(w.queues[p].back());
+                w.queues[p].pop_back();
+                queuedCount[p].fetch_sub(1, std::memory_order_relaxed);
+                priority = p;
+                return true;
+            }
+        }
+        const int start = self >= 0 ? self + 1 : 0;
+        for (int k = 0; k < n; ++k) {
+            const int victim = (start + k) % n;
+            if (victim == self) continue;
+            Worker& w = *workers[victim];
+            std::lock_guard<std::mutex> lock(w.mutex);
+            if (!w.queues[p].empty()) {
+                task = std::move(w.queues[p].front());
+                w.queues[p].pop_front();
+                queuedCount[p].fetch_sub(1, std::memory_order_relaxed);
+                priority = p;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool TaskScheduler::runOne(TaskPriority lowest) {
+    const int bg = static_cast<int>(TaskPriority::Background);
+    const int outer = taskPriority;
+    // a background task waiting on its own loop already holds a background
+    // slot; it runs the loop's chunks in that slot instead of waiting for one
+    const bool nested = outer == bg;
+    Task task;
+    int priority = 0;
+    if (!take(workerIndex, static_cast<int>(lowest), !nested, task, priority)) return false;
+    const bool background = priority == bg && !nested;
+    if (background) backgroundRunning.fetch_add(1, std::memory_order_relaxed);
+    taskPriority = priority;
+    task();
+    taskPriority = outer;
+    if (background) {
+        backgroundRunning.fetch_sub(1, std::memory_order_relaxed);
+        notify();
+    }
+    return true;
+}
+
+bool TaskScheduler::runnable(int lowest, bool limitBackground) const {
+    const int bg = static_cast<int>(TaskPriority::Background);
+    for (int p = 0; p <= lowest && p < bg; ++p)
+        if (queuedCount[p].load(std::memory_order_relaxed) > 0) return true;
+    return lowest >= bg && queuedCount[bg].load(std::memory_order_relaxed) > 0 &&
+           (!limitBackground ||
+            backgroundRunning.load(std::memory_order_relaxed) < backgroundLimit);
+}
+
+void TaskScheduler::workerLoop(int index) {
+    workerIndex = index;
+    while (true) {
+        if (runOne(TaskPriority::Background)) continue;
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this] {
+            return stopping.load() || runnable(static_cast<int>(TaskPriority::Background), true);
+        });
+        if (stopping) return;
+    }
+}
+
+void TaskGroup::run(std::function<void()> fn) {
+    pending.fetch_add(1, std::memory_order_relaxed);
+    TaskScheduler& scheduler = TaskScheduler::instance();
+    scheduler.submit(priority, [this, &scheduler, fn = std::move(fn)]() {
+        fn();
+        // the group may be gone once pending is zero; only the scheduler is touched after
+        if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) scheduler.notify();
+    });
+}
+
+void TaskGroup::wait() {
+    TaskScheduler& scheduler = TaskScheduler::instance();
+    while (pending.load(std::memory_order_acquire) > 0) {
+        if (!scheduler.runOne(priority))
+            scheduler.block(static_cast<int>(priority), pending);
+    }
+}
+
+bool orderedPipeline(int count, int window, TaskPriority priority,
+                     const std::function<bool(int index, int slot)>& produce,
+                     const std::function<bool(int index, int slot, bool produced)>& consume) {
+    if (count <= 0) return true;
+    window = std::clamp(window, 1, count);
+    TaskScheduler& scheduler = TaskScheduler::instance();
+    // 1 while the slot's item is being produced
+    std::unique_ptr<std::atomic<int>[]> pending(new std::atomic<int>[window]);
+    std::vector<char> produced(window, 0);
+    std::atomic<bool> stop{false};
+    TaskGroup group(priority);
+
+    auto submit = [&](int index) {
+        const int slot = index % window;
+        pending[slot].store(1, std::memory_order_relaxed);
+        group.run([&, index, slot]() {
+            produced[slot] = !stop.load(std::memory_order_relaxed) && produce(index, slot);
+            pending[slot].store(0, std::memory_order_release);
+            scheduler.notify();
+        });
+    };
+
+    for (int i = 0; i < window; ++i) submit(i);
+    bool ok = true;
+    for (int i = 0; i < count && ok; ++i) {
+        const int slot = i % window;
+        while (pending[slot].load(std::memory_order_acquire) != 0) {
+            if (!scheduler.runOne(priority))
+                scheduler.block(static_cast<int>(priority), pending[slot]);
+        }
+        ok = consume(i, slot, produced[slot] != 0);
+        if (ok && i + window < count) submit(i + window);
+    }
+    stop = true;
+    group.wait();
+    return ok;
+}
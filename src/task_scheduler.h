@@ -0,0 +1,148 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Which work runs first. Workers always take the most urgent task available;
+// background work never occupies every worker, so an interactive task finds
+// a free one without waiting for a long scan to finish.
+enum class TaskPriority {
+    Interactive = 0,  // render and decode of what is on screen
+    Prefetch = 1,     // fields the user is likely to look at next
+    Background = 2    // file scans, thumbnails
+};
+
+// The application's one thread pool. Each worker owns a deque per priority:
+// it pushes and pops its own work at the back and steals from the front of
+// the others' deques when it runs dry.
+class TaskScheduler {
+public:
+    static constexpr int priorityCount = 3;
+    using Task = std::function<void()>;
+
+    // Must be called before the first instance(); the default is
+    // hardware_concurrency - 1, as the thread waiting on a TaskGroup works too.
+    // With 0 workers everything runs on the submitting thread.
+    // GRIBVIEWER_THREADS=<total threads> replaces the default, not a count
+    // set here (e.g. from a -j option).
+    static void setWorkerCount(unsigned count);
+    static TaskScheduler& instance();
+
+    ~TaskScheduler();
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    unsigned workerCount() const { return static_cast<unsigned>(workers.size()); }
+    // Threads that execute parallelFor bodies: the workers plus the caller.
+    unsigned concurrency() const { return workerCount() + 1; }
+
+    void submit(TaskPriority priority, Task task);
+
+    // Runs one queued task at most as urgent as `lowest` on the calling thread.
+    bool runOne(TaskPriority lowest);
+
+    size_t queued(TaskPriority priority) const {
+        return queuedCount[static_cast<int>(priority)].load(std::memory_order_relaxed);
+    }
+
+    // Index of the calling worker thread, or -1 for any other thread.
+    static int currentWorker();
+    // Priority of the task running on the calling thread; Interactive outside
+    // of one. Work a task splits off inherits it by default.
+    static TaskPriority currentPriority();
+
+private:
+    friend class TaskGroup;
+    friend bool orderedPipeline(int, int, TaskPriority,
+                                const std::function<bool(int, int)>&,
+                                const std::function<bool(int, int, bool)>&);
+    explicit TaskScheduler(unsigned count);
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> queues[priorityCount];
+        std::thread thread;
+    };
+
+    bool take(int self, int lowest, bool limitBackground, Task& task, int& priority);
+    bool runnable(int lowest, bool limitBackground) const;
+    void notify();
+    // Sleeps until `pending` is zero or there is work at most as urgent as
+    // `lowest` to help with.
+    void block(int lowest, const std::atomic<int>& pending);
+    void workerLoop(int index);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<size_t> queuedCount[priorityCount] = {};
+    std::atomic<unsigned> nextWorker{0};
+    std::atomic<int> backgroundRunning{0};
+    int backgroundLimit = 1;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::condition_variable waiters;  // threads blocked in TaskGroup::wait
+    int blockedWaiters = 0;           // guarded by sleepMutex
+    std::atomic<bool> stopping{false};
+};
+
+// A set of tasks that can be waited for. The waiting thread runs queued
+// tasks of the group's priority (or more urgent) and only sleeps when there
+// are none left, until the group is done or new work arrives.
+class TaskGroup {
+public:
+    explicit TaskGroup(TaskPriority priority = TaskScheduler::currentPriority())
+        : priority(priority) {}
+    ~TaskGroup() { wait(); }
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void run(std::function<void()> fn);
+    void wait();
+
+private:
+    TaskPriority priority;
+    std::atomic<int> pending{0};
+};
+
+// Items 0..count-1 are produced as tasks, at most `window` of them ahead of
+// the calling thread, which consumes them in order. Both get the item's index
+// and its slot (index % window) for the caller's per-slot buffers; consume
+// also learns whether produce succeeded and returns false to stop early.
+// While the next item is not ready the caller helps with queued work or
+// sleeps. Returns false if consume stopped the pipeline.
+bool orderedPipeline(int count, int window, TaskPriority priority,
+                     const std::function<bool(int index, int slot)>& produce,
+                     const std::function<bool(int index, int slot, bool produced)>& consume);
+
+// body(i) for i in [begin, end), split into chunks of `grain` indices
+// (default: about four chunks per thread). The calling thread takes part.
+// Chunks run at the caller's priority unless told otherwise, so a loop inside
+// a prefetch or background task does not jump ahead of interactive work.
+template <typename F>
+void parallelFor(long begin, long end, F&& body,
+                 TaskPriority priority = TaskScheduler::currentPriority(), long grain = 0) {
+    const long n = end - begin;
+    if (n <= 0) return;
+    const long threads = static_cast<long>(TaskScheduler::instance().concurrency());
+    if (grain <= 0) grain = std::max(1L, n / (threads * 4));
+    if (threads == 1 || n <= grain) {
+        for (long i = begin; i < end; ++i) body(i);
+        return;
+    }
+
+    TaskGroup group(priority);
+    for (long b = begin + grain; b < end; b += grain) {
+        const long e = std::min(end, b + grain);
+        group.run([&body, b, e]() {
+            for (long i = b; i < e; ++i) body(i);
+        });
+    }
+    for (long i = begin; i < begin + grain; ++i) body(i);
+    group.wait();
+}
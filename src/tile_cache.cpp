@@ -0,0 +1,64 @@
+#include "tile_cache.h"
+
+#include <algorithm>
+
+#include "task_scheduler.h"
+
+const CachedTile* TileCache::find(const TileCacheKey& key) {
+    auto it = index.find(key);
+    if (it == index.end()) {
+        ++misses;
+        return nullptr;
+    }
+    ++hits;
+    lru.splice(lru.begin(), lru, it->second);
+    return &it->second->second;
+}
+
+void TileCache::insert(const TileCacheKey& key, int width, int height,
+                       const std::vector<Color>& pixels) {
+    const size_t n = static_cast<size_t>(width) * height;
+    const size_t size = n * sizeof(uint32_t);
+    if (pixels.size() < n || size > budgetBytes) return;
+
+    auto existing = index.find(key);
+    if (existing != index.end()) {
+        bytesUsed -= existing->second->second.rgba.size() * sizeof(uint32_t);
+        lru.erase(existing->second);
+        index.erase(existing);
+        memory.set(bytesUsed);
+    }
+    const MemoryTracker& tracker = MemoryTracker::instance();
+    while ((bytesUsed + size > budgetBytes || tracker.overBudget(size)) && !lru.empty()) {
+        bytesUsed -= lru.back().second.rgba.size() * sizeof(uint32_t);
+        index.erase(lru.back().first);
+        lru.pop_back();
+        memory.set(bytesUsed);
+    }
+    // the rest of the viewer already uses the budget: caching would only add to it
+    if (tracker.overBudget(size)) return;
+
+    CachedTile tile;
+    tile.width = width;
+    tile.height = height;
+    tile.rgba.resize(n);
+    parallelFor(0, static_cast<long>(n), [&](long i) {
+        const Color& c = pixels[i];
+        uint32_t r = static_cast<uint32_t>(std::clamp(c.r, 0.f, 1.f) * 255.f + 0.5f);
+        uint32_t g = static_cast<uint32_t>(std::clamp(c.g, 0.f, 1.f) * 255.f + 0.5f);
+        uint32_t b = static_cast<uint32_t>(std::clamp(c.b, 0.f, 1.f) * 255.f + 0.5f);
+        tile.rgba[i] = r | (g << 8) | (b << 16) | (0xffu << 24);
+    });
+
+    lru.emplace_front(key, std::move(tile));
+    index[key] = lru.begin();
+    bytesUsed += size;
+    memory.set(bytesUsed);
+}
+
+void TileCache::clear() {
+    lru.clear();
+    index.clear();
+    bytesUsed = 0;
+    memory.set(0);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+#include "gradient.h"
+#include "memory_tracker.h"
+
+// Identifies one rendered tile. tileSize == 0 marks a whole-image entry
+// (tx = ty = 0); level is the FieldPyramid level, 0 for full resolution.
+struct TileCacheKey {
+    size_t globalIndex;
+    uint64_t settingsHash;
+    int level;
+    int tileSize;
+    int tx;
+    int ty;
+
+    bool operator==(const TileCacheKey& o) const {
+        return globalIndex == o.globalIndex && settingsHash == o.settingsHash &&
+               level == o.level && tileSize == o.tileSize && tx == o.tx && ty == o.ty;
+    }
+};
+
+struct TileCacheKeyHash {
+    size_t operator()(const TileCacheKey& k) const {
+        size_t h = 1469598103934665603ull;
+        auto mix = [&h](size_t v) { h ^= v + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2); };
+        mix(k.globalIndex);
+        mix(static_cast<size_t>(k.settingsHash));
+        mix(static_cast<size_t>(k.level));
+        mix(static_cast<size_t>(k.tileSize));
+        mix(static_cast<size_t>(k.tx));
+        mix(static_cast<size_t>(k.ty));
+        return h;
+    }
+};
+
+struct CachedTile {
+    int width = 0;
+    int height = 0;
+    std::vector<uint32_t> rgba;  // RGBA8, row-major, same row order as the render
+};
+
+// Rendered tiles as packed RGBA8, bounded by budgetBytes and the global
+// MemoryTracker budget with LRU eviction. A hit replaces the CPU colouring
+// pass by a plain texture upload.
+class TileCache {
+public:
+    size_t budgetBytes = size_t(512) << 20;
+
+    const CachedTile* find(const TileCacheKey& key);
+    void insert(const TileCacheKey& key, int width, int height, const std::vector<Color>& pixels);
+    void clear();
+
+    size_t bytes() const { return bytesUsed; }
+    size_t entries() const { return index.size(); }
+    size_t hits = 0;
+    size_t misses = 0;
+
+private:
+    using Entry = std::pair<TileCacheKey, CachedTile>;
+    std::list<Entry> lru;  // front = most recently used
+    std::unordered_map<TileCacheKey, std::list<Entry>::iterator, TileCacheKeyHash> index;
+    size_t bytesUsed = 0;
+    MemoryCharge memory{MemCategory::TileCache};
+};
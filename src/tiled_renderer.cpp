@@ -0,0 +1,135 @@
+#include "tiled_renderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <imgui.h>
+
+#include "memory_tracker.h"
+#include "renderer.h"
+#include "trace.h"
+
+TiledRenderer::TiledRenderer() {
+}
+
+TiledRenderer::~TiledRenderer() {
+}
+
+bool TiledRenderer::needsTiling(const GribField& field) {
+    static GLint maxTextureSize = 0;
+    if (maxTextureSize == 0)
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    return field.width > maxTextureSize || field.height > maxTextureSize;
+}
+
+void TiledRenderer::invalidate() {
+    for (auto& [key, tile] : tiles)
+        tile.valid = false;
+}
+
+void TiledRenderer::clear() {
+    for (auto& [key, tile] : tiles)
+        Renderer::deleteTexture(tile.texture);
+    tiles.clear();
+    bytesResident = 0;
+}
+
+void TiledRenderer::draw(Renderer& renderer, const GribField& field, size_t globalIndex,
+                         GribViewerSettings& settings) {
+    TRACE_SCOPE("tiledDraw", "render");
+    ++frame;
+    if (field.values.empty() || field.width == 0 || field.height == 0) {
+        ImGui::Text("No data to display");
+        return;
+    }
+
+    const int width = static_cast<int>(field.width);
+    const int height = static_cast<int>(field.height);
+    const float zoom = static_cast<float>(settings.displayZoomFactor);
+    const bool flipped = field.jScansPositively;
+
+    // Reserve the full extent so the window scrollbars behave as for one image;
+    // origin already includes the scroll offset.
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    ImGui::Dummy(ImVec2(width * zoom, height * zoom));
+
+    ImVec2 winPos = ImGui::GetWindowPos();
+    ImVec2 winSize = ImGui::GetWindowSize();
+    float visX0 = std::max(0.f, winPos.x - origin.x);
+    float visX1 = std::min(width * zoom, winPos.x + winSize.x - origin.x);
+    float visY0 = std::max(0.f, winPos.y - origin.y);
+    float visY1 = std::min(height * zoom, winPos.y + winSize.y - origin.y);
+    if (visX0 >= visX1 || visY0 >= visY1) {
+        evict();
+        return;
+    }
+
+    // Visible region in field coordinates; display row 0 is the last field
+    // row when the grid scans north-to-south in j.
+    int fx0 = static_cast<int>(visX0 / zoom);
+    int fx1 = static_cast<int>(std::ceil(visX1 / zoom));
+    int fy0 = flipped ? height - static_cast<int>(std::ceil(visY1 / zoom)) : static_cast<int>(visY0 / zoom);
+    int fy1 = flipped ? height - static_cast<int>(visY0 / zoom) : static_cast<int>(std::ceil(visY1 / zoom));
+    fx0 = std::clamp(fx0, 0, width);
+    fx1 = std::clamp(fx1, 0, width);
+    fy0 = std::clamp(fy0, 0, height);
+    fy1 = std::clamp(fy1, 0, height);
+
+    const uint64_t settingsHash = renderSettingsHash(settings);
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    for (int ty = fy0 / tileSize; ty * tileSize < fy1; ++ty) {
+        for (int tx = fx0 / tileSize; tx * tileSize < fx1; ++tx) {
+            const int x0 = tx * tileSize;
+            const int y0 = ty * tileSize;
+            const int tw = std::min(tileSize, width - x0);
+            const int th = std::min(tileSize, height - y0);
+
+            Tile& tile = tiles[tileKey(tx, ty)];
+            if (tile.texture == 0 || tile.width != tw || tile.height != th) {
+                if (tile.texture != 0) {
+                    Renderer::deleteTexture(tile.texture);
+                    bytesResident -= tileBytes(tile.width, tile.height);
+                }
+                tile.texture = renderer.createTexture(tw, th);
+                tile.width = tw;
+                tile.height = th;
+                tile.valid = false;
+                bytesResident += tileBytes(tw, th);
+            }
+            if (!tile.valid) {
+                TileCacheKey key{globalIndex, settingsHash, 0, tileSize, tx, ty};
+                if (!renderer.uploadFromCache(tile.texture, key)) {
+                    scratch.resize(static_cast<size_t>(tw) * th);
+                    renderer.renderRegion(field, x0, y0, tw, th, settings, scratch);
+                    renderer.updateTexture(tile.texture, tw, th, scratch);
+                    // not while a slider is dragged: those settings rarely come back
+                    if (!ImGui::IsAnyItemActive())
+                        renderer.tileCache.insert(key, tw, th, scratch);
+                }
+                tile.valid = true;
+            }
+            tile.lastUsed = frame;
+
+            float dispY0 = flipped ? static_cast<float>(height - y0 - th) : static_cast<float>(y0);
+            ImVec2 pMin(origin.x + x0 * zoom, origin.y + dispY0 * zoom);
+            ImVec2 pMax(pMin.x + tw * zoom, pMin.y + th * zoom);
+            drawList->AddImage((ImTextureID)(intptr_t)tile.texture, pMin, pMax, fieldUv1(field), fieldUv2(field));
+        }
+    }
+
+    evict();
+}
+
+void TiledRenderer::evict() {
+    while (bytesResident > memoryBudget || MemoryTracker::instance().overBudget()) {
+        auto victim = tiles.end();
+        for (auto it = tiles.begin(); it != tiles.end(); ++it) {
+            if (it->second.lastUsed == frame) continue;
+            if (victim == tiles.end() || it->second.lastUsed < victim->second.lastUsed)
+                victim = it;
+        }
+        if (victim == tiles.end()) break;  // everything left is on screen
+        Renderer::deleteTexture(victim->second.texture);
+        bytesResident -= tileBytes(victim->second.width, victim->second.height);
+        tiles.erase(victim);
+    }
+}
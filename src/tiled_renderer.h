@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <GL/gl.h>
+
+#include "grib_reader.h"
+#include "settings.h"
+
+class Renderer;
+
+// Viewport-aware CPU renderer: the field is split into fixed-size tiles and
+// only the tiles intersecting the visible part of the current ImGui window are
+// coloured and uploaded. Off-screen tiles are kept as long as they fit in
+// memoryBudget and evicted least-recently-used first.
+class TiledRenderer {
+public:
+    static constexpr int tileSize = 512;
+    size_t memoryBudget = size_t(256) << 20;
+
+    TiledRenderer();
+    ~TiledRenderer();
+
+    // Fields larger than GL_MAX_TEXTURE_SIZE cannot be shown as one texture.
+    static bool needsTiling(const GribField& field);
+
+    // Colours changed (field, range, colormap): tiles are re-rendered on demand.
+    void invalidate();
+    void clear();
+
+    // Lays out the whole field (zoomed) in the current window and draws the
+    // visible tiles through the window draw list.
+    // globalIndex identifies the field in the renderer's TileCache.
+    void draw(Renderer& renderer, const GribField& field, size_t globalIndex,
+              GribViewerSettings& settings);
+
+    size_t residentBytes() const { return bytesResident; }
+    size_t residentTiles() const { return tiles.size(); }
+
+private:
+    struct Tile {
+        GLuint texture = 0;
+        int width = 0;
+        int height = 0;
+        bool valid = false;
+        uint64_t lastUsed = 0;
+    };
+
+    static uint64_t tileKey(int tx, int ty) {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(ty)) << 32) | static_cast<uint32_t>(tx);
+    }
+    static size_t tileBytes(int w, int h) { return static_cast<size_t>(w) * h * sizeof(Color); }
+
+    void evict();
+
+    std::unordered_map<uint64_t, Tile> tiles;
+    std::vector<Color> scratch;
+    size_t bytesResident = 0;
+    uint64_t frame = 0;
+};
@@ -0,0 +1,138 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+Tracer& Tracer::instance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+uint64_t Tracer::nowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void Tracer::setEnabled(bool enable) {
+    on.store(enable, std::memory_order_relaxed);
+}
+
+Tracer::ThreadRing& Tracer::localRing() {
+    // Rings are owned by the tracer, so spans of finished worker threads
+    // survive until export.
+    thread_local ThreadRing* ring = nullptr;
+    if (!ring) {
+        auto owned = std::make_unique<ThreadRing>();
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        owned->tid = static_cast<uint32_t>(rings.size() + 1);
+        ring = owned.get();
+        rings.push_back(std::move(owned));
+    }
+    return *ring;
+}
+
+void Tracer::record(const char* name, const char* category, uint64_t beginNs, uint64_t endNs) {
+    ThreadRing& ring = localRing();
+    // only contended while an export or the overlay reads this ring
+    std::lock_guard<std::mutex> lock(ring.mutex);
+    ring.events[ring.head % ringSize] = TraceEvent{name, category, beginNs, endNs};
+    ++ring.head;
+}
+
+void Tracer::clear() {
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    for (auto& ring : rings) {
+        std::lock_guard<std::mutex> ringLock(ring->mutex);
+        ring->head = 0;
+    }
+}
+
+void Tracer::initFromEnv() {
+    const char* path = std::getenv("GRIBVIEWER_TRACE");
+    if (!path || !*path) return;
+    envPath = path;
+    setEnabled(true);
+}
+
+void Tracer::markFirstField() {
+    if (firstFieldNs.load(std::memory_order_relaxed) != 0) return;
+    const uint64_t now = nowNs();
+    uint64_t expected = 0;
+    if (!firstFieldNs.compare_exchange_strong(expected, std::max<uint64_t>(1, now - startNs)))
+        return;
+    if (enabled()) record("timeToFirstField", "startup", startNs, now);
+}
+
+void Tracer::writeEnvTrace() {
+    if (envPath.empty()) return;
+    if (writeChromeTrace(envPath))
+        std::fprintf(stderr, "Trace written to %s\n", envPath.c_str());
+    else
+        std::fprintf(stderr, "Failed to write trace to %s\n", envPath.c_str());
+}
+
+static void writeJsonString(FILE* f, const char* s) {
+    std::fputc('"', f);
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') std::fputc('\\', f);
+        std::fputc(*s, f);
+    }
+    std::fputc('"', f);
+}
+
+bool Tracer::writeChromeTrace(const std::string& path) {
+    FILE* f = std::fopen(path.c_str(), "w");
+    if (!f) return false;
+
+    std::fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    bool first = true;
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    for (auto& ring : rings) {
+        std::lock_guard<std::mutex> ringLock(ring->mutex);
+        uint64_t count = std::min<uint64_t>(ring->head, ringSize);
+        for (uint64_t i = ring->head - count; i < ring->head; ++i) {
+            const TraceEvent& e = ring->events[i % ringSize];
+            std::fprintf(f, "%s{\"name\": ", first ? "" : ",\n");
+            writeJsonString(f, e.name);
+            std::fprintf(f, ", \"cat\": ");
+            writeJsonString(f, e.category);
+            std::fprintf(f, ", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}",
+                ring->tid, e.beginNs * 1e-3, (e.endNs - e.beginNs) * 1e-3);
+            first = false;
+        }
+    }
+    std::fprintf(f, "\n]}\n");
+    return std::fclose(f) == 0;
+}
+
+void Tracer::frameMark() {
+    uint64_t now = nowNs();
+    if (frameStartNs != 0) lastFrameNs = now - frameStartNs;
+    prevFrameStartNs = frameStartNs;
+    frameStartNs = now;
+}
+
+void Tracer::lastFrameStages(std::vector<TraceStage>& out) {
+    out.clear();
+    if (prevFrameStartNs == 0) return;
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    for (auto& ring : rings) {
+        std::lock_guard<std::mutex> ringLock(ring->mutex);
+        uint64_t count = std::min<uint64_t>(ring->head, ringSize);
+        // events are stored in order of completion, so walk back from the newest
+        for (uint64_t n = 0; n < count; ++n) {
+            const TraceEvent& e = ring->events[(ring->head - 1 - n) % ringSize];
+            if (e.endNs < prevFrameStartNs) break;
+            if (e.endNs >= frameStartNs) continue;
+            auto it = std::find_if(out.begin(), out.end(), [&](const TraceStage& s) {
+                return s.name == e.name || std::strcmp(s.name, e.name) == 0;
+            });
+            double ms = (e.endNs - e.beginNs) * 1e-6;
+            if (it == out.end()) out.push_back(TraceStage{e.name, ms, 1});
+            else { it->ms += ms; ++it->count; }
+        }
+    }
+}
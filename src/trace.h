@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Lightweight span tracing. Each thread records completed spans into its own
+// ring buffer; the rings are exported as Chrome trace JSON (chrome://tracing,
+// ui.perfetto.dev). While tracing is off a span costs one relaxed load.
+//
+//   TRACE_SCOPE("readField", "decode");
+//
+// Names and categories must be string literals (only the pointer is kept).
+
+struct TraceEvent {
+    const char* name;
+    const char* category;
+    uint64_t beginNs;
+    uint64_t endNs;
+};
+
+// Summed time of one span name within a frame.
+struct TraceStage {
+    const char* name;
+    double ms;
+    int count;
+};
+
+class Tracer {
+public:
+    static constexpr size_t ringSize = 1 << 16;
+
+    static Tracer& instance();
+
+    bool enabled() const { return on.load(std::memory_order_relaxed); }
+    void setEnabled(bool enable);
+
+    static uint64_t nowNs();
+    void record(const char* name, const char* category, uint64_t beginNs, uint64_t endNs);
+    void clear();
+
+    // GRIBVIEWER_TRACE=<file>: enable tracing now; writeEnvTrace() writes it.
+    void initFromEnv();
+    void writeEnvTrace();
+    bool writeChromeTrace(const std::string& path);
+
+    // Startup milestone. The first call records a "timeToFirstField" span
+    // from the tracer's creation (the top of main) to now.
+    void markFirstField();
+    // Negative until a field has been decoded.
+    double timeToFirstFieldMs() const {
+        const uint64_t ns = firstFieldNs.load(std::memory_order_relaxed);
+        return ns != 0 ? ns * 1e-6 : -1.0;
+    }
+
+    // Frame boundaries on the UI thread, for per-frame stage timings.
+    void frameMark();
+    double lastFrameMs() const { return lastFrameNs * 1e-6; }
+    // Spans (any thread) that ended in the previous frame, summed per name.
+    void lastFrameStages(std::vector<TraceStage>& out);
+
+private:
+    Tracer() = default;
+
+    struct ThreadRing {
+        std::mutex mutex;
+        uint32_t tid = 0;
+        uint64_t head = 0;
+        TraceEvent events[ringSize];
+    };
+
+    ThreadRing& localRing();
+
+    std::atomic<bool> on{false};
+    std::mutex ringsMutex;
+    std::vector<std::unique_ptr<ThreadRing>> rings;
+    std::string envPath;
+    uint64_t startNs = nowNs();
+    std::atomic<uint64_t> firstFieldNs{0};
+    uint64_t frameStartNs = 0;
+    uint64_t prevFrameStartNs = 0;
+    uint64_t lastFrameNs = 0;
+};
+
+class TraceSpan {
+public:
+    TraceSpan(const char* name, const char* category)
+        : name(name), category(category),
+          beginNs(Tracer::instance().enabled() ? Tracer::nowNs() : 0) {}
+    ~TraceSpan() {
+        if (beginNs != 0) Tracer::instance().record(name, category, beginNs, Tracer::nowNs());
+    }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name;
+    const char* category;
+    uint64_t beginNs;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name, category) TraceSpan TRACE_CONCAT(traceSpan_, __LINE__)(name, category)
@@ -0,0 +1,83 @@
+#include "gradientAtlas.h"
+
+#include <algorithm>
+
+#include "../color_adjust.h"
+#include "../task_scheduler.h"
+#include "../trace.h"
+
+static uint64_t hclParamsHash(float brightness, float gamma, float vibrancy, float hueShift) {
+    float params[4] = { brightness, gamma, vibrancy, hueShift };
+    uint64_t h = 1469598103934665603ull;
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(params);
+    for (size_t i = 0; i < sizeof(params); ++i) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h | 1;  // 0 marks a row that was never built
+}
+
+void GradientPreviewAtlas::allocate(int rows) {
+    if (texture == 0)
+        glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, previewWidth, rows, 0, GL_RGB, GL_FLOAT, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    rowCount = rows;
+    rowParams.assign(rows, 0);
+    memory.set(static_cast<size_t>(previewWidth) * rows * sizeof(Color) +
+               rowData.capacity() * sizeof(Color));
+}
+
+void GradientPreviewAtlas::ensureRows(const GradientRegistry& gradients, int first, int last,
+                                      float brightness, float gamma, float vibrancy, float hueShift) {
+    TRACE_SCOPE("gradientPreviews", "render");
+    if (rowCount != static_cast<int>(gradients.size()))
+        allocate(static_cast<int>(gradients.size()));
+    first = std::max(first, 0);
+    last = std::min(last, rowCount);
+    if (first >= last) return;
+
+    const uint64_t params = hclParamsHash(brightness, gamma, vibrancy, hueShift);
+    std::vector<int> stale;
+    for (int row = first; row < last; ++row)
+        if (rowParams[row] != params) stale.push_back(row);
+    if (stale.empty()) return;
+
+    rowData.resize(static_cast<size_t>(last - first) * previewWidth);
+    memory.set(static_cast<size_t>(previewWidth) * rowCount * sizeof(Color) +
+               rowData.capacity() * sizeof(Color));
+    const int staleCount = static_cast<int>(stale.size());
+    parallelFor(0, staleCount, [&](long i) {
+        const int row = stale[i];
+        // first use of a gradient builds its LUT; that happens here, in parallel
+        const GradientLut& lut = gradients.lut(static_cast<GradientHandle>(row));
+        for (int x = 0; x < previewWidth; ++x) {
+            float t = static_cast<float>(x) / (previewWidth - 1);
+            rowData[static_cast<size_t>(row - first) * previewWidth + x] =
+                applyHclAdjustments(lut.sample(t), brightness, gamma, vibrancy, hueShift);
+        }
+    }, TaskPriority::Interactive, 1);
+
+    // one upload per run of consecutive stale rows
+    glBindTexture(GL_TEXTURE_2D, texture);
+    for (int i = 0; i < staleCount;) {
+        int j = i + 1;
+        while (j < staleCount && stale[j] == stale[j - 1] + 1) ++j;
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, stale[i], previewWidth, j - i, GL_RGB, GL_FLOAT,
+                        rowData.data() + static_cast<size_t>(stale[i] - first) * previewWidth);
+        for (int k = i; k < j; ++k) rowParams[stale[k]] = params;
+        i = j;
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void GradientPreviewAtlas::image(int row, const ImVec2& size) const {
+    // sample the row's texel centre so neighbouring rows never bleed in
+    const float v = (row + 0.5f) / static_cast<float>(rowCount);
+    ImGui::Image((ImTextureID)(intptr_t)texture, size, ImVec2(0, v), ImVec2(1, v));
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <imgui.h>
+#include <GL/gl.h>
+
+#include "../gradient_registry.h"
+#include "../memory_tracker.h"
+
+// All gradient previews packed into one texture, one row per gradient.
+// Rows are (re)built lazily for the HCL parameters in effect, only when
+// requested, i.e. for the rows the Gradient combo actually shows.
+class GradientPreviewAtlas {
+public:
+    static constexpr int previewWidth = 256;
+
+    // Rebuilds the stale rows in [first, last) in parallel and uploads them.
+    void ensureRows(const GradientRegistry& gradients, int first, int last,
+                    float brightness, float gamma, float vibrancy, float hueShift);
+    void image(int row, const ImVec2& size) const;
+
+private:
+    void allocate(int rows);
+
+    GLuint texture = 0;
+    int rowCount = 0;
+    std::vector<uint64_t> rowParams;  // HCL parameter hash each row was built for
+    std::vector<Color> rowData;
+    MemoryCharge memory{MemCategory::GradientPreviews};
+};
@@ -37,6 +37,17 @@ void showMainwindow(Renderer& renderer, char filename[512], GribCollection& coll
     static int displayWidth = 0;
     static int displayHeight = 0;
     static std::vector<Color> imgData;
+    // GPU LUT backend state; imgData is only refreshed lazily while it is active
+    static bool lutFieldDirty = true;
+    static bool lutGradientDirty = true;
+    static bool showingLut = false;
+    static bool showingTiles = false;
+    static bool imgDataStale = false;
+    static int shownLevel = 0;
+    static TileCacheKey progressiveKey{};
+    // image on screen that goes into the TileCache once no slider is dragged
+    static bool cachePending = false;
+    static TileCacheKey pendingKey{};
 
     // add a color bar
     static bool updateCbarTexture = true;
@@ -51,30 +62,29 @@ void showMainwindow(Renderer& renderer, char filename[512], GribCollection& coll
     static GribViewerSettings settings;
     static GribViewerSettings settings_old;
 
-    static bool genGradientPreview = true;
-    static float previewBrightness = -1.0f;
-    static float previewGamma = -1.0f;
-    static float previewVibrancy = -1.0f;
-    static float previewHueShift = 0.0f;
-    if (previewBrightness != settings.brightness ||
-        previewGamma != settings.gamma ||
-        previewVibrancy != settings.vibrancy ||
-        previewHueShift != settings.hueShift) {
-        genGradientPreview = true;
-        previewBrightness = settings.brightness;
-        previewGamma = settings.gamma;
-        previewVibrancy = settings.vibrancy;
-        previewHueShift = settings.hueShift;
-    }
-    if (genGradientPreview) {
-        for ( auto& grad : mpl_gradients) {
-            rebuildGradientPreview(grad, settings.brightness, settings.gamma,
-                                   settings.vibrancy, settings.hueShift);
-        }
-        genGradientPreview = false;
-    }
+    static GradientPreviewAtlas gradientAtlas;
+    static bool showTraceOverlay = false;
+    static bool showMemoryWindow = false;
+    static MemoryCharge imgDataMemory{MemCategory::ImageBuffers};
+    static AnimationPlayer animation;
+    static std::vector<size_t> animationSeries;
+    static AnimationExportJob animationExport;
+    static bool exportPopupPending = false;
+    static PngLevel pngLevel = PngLevel::Default;
+    static bool palettePng = false;
+    static bool valuesFloat32 = false;
+    // exports asked for during playback; they run once the shown message is read
+    static bool pendingExport = false;
+    static bool pendingCopy = false;
+    static bool pendingExportValues = false;
+
+    FrameScheduler& frames = FrameScheduler::instance();
+    frames.waitForFrame();
+
+    Tracer& tracer = Tracer::instance();
+    tracer.frameMark();
+    TRACE_SCOPE("frame", "ui");
 
-    glfwPollEvents();
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
@@ -98,6 +108,14 @@ void showMainwindow(Renderer& renderer, char filename[512], GribCollection& coll
     bool doOpen = false;
     bool doExport = false;
     bool doCopy = false;
+    bool doExportTrace = false;
+    bool doExportAnimation = false;
+    bool doExportValues = false;
+    int doSaveGrib = 0;  // 1: current message, 2: its animation series
+    const bool haveMessages = collection.fileLoaded && !collection.messageList.empty();
+    // imgData stays empty in the tiled view, so ask for a shown field instead
+    const bool haveImage = displayWidth > 0 && displayHeight > 0 &&
+                           !collection.currentField.values.empty();
 
     if (io.KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_O)) doOpen = true;
     if (io.KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_E)) doExport = true;
@@ -106,16 +124,54 @@ void showMainwindow(Renderer& renderer, char filename[512], GribCollection& coll
     if (ImGui::BeginMenuBar()) {
         if (ImGui::BeginMenu("File")) {
             if (ImGui::MenuItem("Open", "Ctrl+O")) doOpen = true;
-            if (ImGui::MenuItem("Export Image", "Ctrl+E", false, !imgData.empty())) doExport = true;
+            if (ImGui::MenuItem("Export Image", "Ctrl+E", false, haveImage)) doExport = true;
+            if (ImGui::BeginMenu("PNG Options")) {
+                static const char* levelNames[] = { "Fastest", "Fast", "Default", "Smallest" };
+                for (int i = 0; i < 4; ++i) {
+                    if (ImGui::MenuItem(levelNames[i], nullptr, static_cast<int>(pngLevel) == i))
+                        pngLevel = static_cast<PngLevel>(i);
+                }
+                ImGui::Separator();
+                ImGui::MenuItem("Palette PNG", nullptr, &palettePng);
+                ImGui::EndMenu();
+            }
+            if (ImGui::BeginMenu("Export Values", !collection.currentField.values.empty())) {
+                if (ImGui::MenuItem("Save...")) doExportValues = true;
+                ImGui::MenuItem("Float32", nullptr, &valuesFloat32);
+                ImGui::EndMenu();
+            }
+            if (ImGui::BeginMenu("Save as GRIB", haveMessages)) {
+                if (ImGui::MenuItem("Current Message...")) doSaveGrib = 1;
+                if (ImGui::MenuItem("Animation Series...")) doSaveGrib = 2;
+                ImGui::EndMenu();
+            }
+            if (ImGui::MenuItem("Export Animation...", nullptr, false,
+                                haveMessages && !animationExport.running()))
+                doExportAnimation = true;
             ImGui::EndMenu();
         }
         if (ImGui::BeginMenu("Edit")) {
-            if (ImGui::MenuItem("Copy Image", "Ctrl+C", false, !imgData.empty())) doCopy = true;
+            if (ImGui::MenuItem("Copy Image", "Ctrl+C", false, haveImage)) doCopy = true;
+            ImGui::EndMenu();
+        }
+        if (ImGui::BeginMenu("Tools")) {
+            bool tracing = tracer.enabled();
+            if (ImGui::MenuItem("Enable Tracing", nullptr, &tracing)) tracer.setEnabled(tracing);
+            ImGui::MenuItem("Trace Overlay", nullptr, &showTraceOverlay);
+            if (ImGui::MenuItem("Export Trace...")) doExportTrace = true;
+            if (ImGui::MenuItem("Clear Trace")) tracer.clear();
+            ImGui::Separator();
+            ImGui::MenuItem("Memory Dashboard", nullptr, &showMemoryWindow);
+            ImGui::MenuItem("Continuous Redraw", nullptr, &frames.continuous);
             ImGui::EndMenu();
         }
         ImGui::EndMenuBar();
     }
 
+    if (doOpen && animationExport.running()) {
+        std::cerr << "Wait for the animation export to finish before opening files" << std::endl;
+        doOpen = false;
+    }
     if (doOpen) {
         const char* filters[] = { "*.grib", "*.grib2", "*.grb", "*.grb2", "*" };
         const char* selected = tinyfd_openFileDialog(
@@ -126,7 +182,10 @@ void showMainwindow(Renderer& renderer, char filename[512], GribCollection& coll
             if (!paths.empty()) {
                 strncpy(filename, paths.front().c_str(), 511);
                 filename[511] = '\0';
+                animation.stop();
                 collection.beginLoad(paths);
+                renderer.tileCache.clear();
+                renderer.progressiveRenderer.cancel();
                 currentMessage = 0;
                 previousMessage = -1;
                 needNewTexture = true;
@@ -134,26 +193,163 @@ void showMainwindow(Renderer& renderer, char filename[512], GribCollection& coll
             }
         }
     }
-    if (doExport && !imgData.empty()) {
+    if (animation.active() && (doExport || doCopy || doExportValues)) {
+        // collection.currentField and imgData still hold the message playback
+        // started from: stop on the one shown and export it next frame
+        animation.stop();
+        previousMessage = -1;
+        pendingExport = pendingExport || doExport;
+        pendingCopy = pendingCopy || doCopy;
+        pendingExportValues = pendingExportValues || doExportValues;
+        doExport = doCopy = doExportValues = false;
+        frames.requestFrame();
+    } else if (!animation.active()) {
+        doExport = doExport || pendingExport;
+        doCopy = doCopy || pendingCopy;
+        doExportValues = doExportValues || pendingExportValues;
+        pendingExport = pendingCopy = pendingExportValues = false;
+    }
+    if ((doExport || doCopy) && imgDataStale && !imgData.empty()) {
+        const bool wasProgressive = renderer.progressiveRenderer.running();
+        renderer.progressiveRenderer.cancel();
+        if (shownLevel > 0)
+            renderer.renderLevel(collection.currentField, shownLevel, settings, imgData);
+        else
+            renderer.renderField(collection.currentField, displayWidth, displayHeight, settings,
+                                 imgData);
+        if (wasProgressive)
+            renderer.updateTexture(fieldTexture, displayWidth, displayHeight, imgData);
+        imgDataStale = false;
+    }
+    if (doExport && haveImage) {
         const char* filters[] = { "*.png" };
         const char* selected = tinyfd_saveFileDialog(
             "Export Image", "export.png", 1, filters, "PNG Images");
         if (selected) {
-            if (exportImagePng(selected, displayWidth, displayHeight, imgData, collection.currentField.jScansPositively)) {
+            // a palette image is coloured straight from the field (or the pyramid
+            // level shown), at the same size
+            const GribField& field = collection.currentField;
+            bool ok;
+            if (imgData.empty()) {
+                // tiled view: stream the image in bands instead of holding all of it
+                BandedExportOptions options;
+                options.palette = palettePng;
+                options.level = pngLevel;
+                ok = exportFieldPngBanded(selected, field, displayWidth, displayHeight, settings,
+                                          options);
+            } else if (palettePng) {
+                std::vector<unsigned char> indices;
+                std::vector<unsigned char> palette;
+                colormapPalette(settings, palette);
+                const ColorizeStatus status = shownLevel > 0
+                    ? colorizeLevelIndexed(field, shownLevel, settings, indices)
+                    : colorizeFieldIndexed(field, displayWidth, displayHeight, settings, indices);
+                ok = status == ColorizeStatus::Ok &&
+                     exportImagePngIndexed(selected, displayWidth, displayHeight, indices, palette,
+                                           field.jScansPositively, pngLevel);
+            } else {
+                ok = exportImagePng(selected, displayWidth, displayHeight, imgData,
+                                    field.jScansPositively, pngLevel);
+            }
+            if (ok) {
                 std::cout << "Exported image to " << selected << std::endl;
             } else {
                 std::cerr << "Failed to export image to " << selected << std::endl;
             }
         }
     }
-    if (doCopy && !imgData.empty()) {
-        if (copyImageToClipboard(displayWidth, displayHeight, imgData, collection.currentField.jScansPositively)) {
+    if (doCopy && haveImage) {
+        // the tiled view keeps no full image; colour one just for the copy
+        std::vector<Color> tiledImage;
+        if (imgData.empty()) {
+            tiledImage.resize(static_cast<size_t>(displayWidth) * displayHeight);
+            renderer.renderField(collection.currentField, displayWidth, displayHeight, settings,
+                                 tiledImage);
+        }
+        const std::vector<Color>& image = imgData.empty() ? tiledImage : imgData;
+        if (copyImageToClipboard(displayWidth, displayHeight, image, collection.currentField.jScansPositively)) {
             std::cout << "Image copied to clipboard" << std::endl;
         } else {
             std::cerr << "Failed to copy image to clipboard" << std::endl;
         }
     }
 
+    if (doExportValues) {
+        const char* filters[] = { "*.npy", "*.bin" };
+        const char* selected = tinyfd_saveFileDialog(
+            "Export Values", "values.npy", 2, filters, "NumPy array or raw binary with JSON header");
+        ValuesFormat format;
+        if (selected && !valuesFormatFromName(selected, format)) {
+            std::cerr << "Unknown values format: " << selected << std::endl;
+        } else if (selected) {
+            // step and dates of the message the values came from
+            const int pos = findSortedPos(collection.messageList, collection.currentGlobalIndex);
+            const GribMessageInfo* info = pos >= 0 ? &collection.messageList[pos] : nullptr;
+            if (exportFieldValues(selected, collection.currentField, info, format,
+                                  valuesFloat32 ? ValuesType::Float32 : ValuesType::Float64)) {
+                std::cout << "Exported values to " << selected << std::endl;
+            } else {
+                std::cerr << "Failed to export values to " << selected << std::endl;
+            }
+        }
+    }
+
+    if (doSaveGrib) {
+        const char* filters[] = { "*.grib", "*.grib2", "*.grb" };
+        const char* selected = tinyfd_saveFileDialog(
+            "Save as GRIB", "selection.grib", 3, filters, "GRIB Files");
+        const int pos = findSortedPos(collection.messageList, static_cast<size_t>(currentMessage));
+        if (selected && pos >= 0) {
+            std::vector<size_t> messages;
+            if (doSaveGrib == 2)
+                collection.seriesFor(collection.messageList[pos], animation.axis, messages);
+            else
+                messages.push_back(static_cast<size_t>(currentMessage));
+            GribCopyStats stats;
+            if (saveMessagesAsGrib(selected, collection, messages, &stats)) {
+                std::cout << "Saved " << stats.messages << " messages (" << stats.bytes
+                          << " bytes) to " << selected << std::endl;
+            } else {
+                std::cerr << "Failed to save GRIB to " << selected << std::endl;
+            }
+        }
+    }
+
+    if (doExportAnimation) {
+        const char* filters[] = { "*.png", "*.gif", "*.y4m" };
+        const char* selected = tinyfd_saveFileDialog(
+            "Export Animation", "animation.png", 3, filters, "APNG, GIF or Y4M video");
+        AnimationExportOptions options;
+        if (selected && !animationFormatFromName(selected, options.format)) {
+            std::cerr << "Unknown animation format: " << selected << std::endl;
+        } else if (selected) {
+            // same series, rate and looping as the player
+            const auto& cur = collection.messageList[
+                findSortedPos(collection.messageList, static_cast<size_t>(currentMessage))];
+            std::vector<size_t> series;
+            collection.seriesFor(cur, animation.axis, series);
+            options.fps = animation.fps;
+            options.loop = animation.loop;
+            options.pngLevel = pngLevel;
+            animationExport.start(selected, collection, std::move(series), settings, options,
+                                  [] { FrameScheduler::instance().requestFrame(); });
+            exportPopupPending = true;
+        }
+    }
+
+    if (doExportTrace) {
+        const char* filters[] = { "*.json" };
+        const char* selected = tinyfd_saveFileDialog(
+            "Export Trace", "gribviewer_trace.json", 1, filters, "Chrome Trace (JSON)");
+        if (selected) {
+            if (tracer.writeChromeTrace(selected)) {
+                std::cout << "Exported trace to " << selected << std::endl;
+            } else {
+                std::cerr << "Failed to export trace to " << selected << std::endl;
+            }
+        }
+    }
+
     ImGuiID dockspace_id = ImGui::GetID("MyDockSpace");
     ImGui::DockSpace(dockspace_id, ImVec2(0.0f, 0.0f), ImGuiDockNodeFlags_None);
 
@@ -242,32 +438,103 @@ void showMainwindow(Renderer& renderer, char filename[512], GribCollection& coll
             }
         }
 
+        // Play/pause along steps, levels or members. While playing, the animation
+        // owns the display and currentMessage follows the frame on screen.
+        {
+            const bool playing = animation.active();
+            bool toggle = ImGui::Button(playing ? "Pause" : "Play");
+            if (!ImGui::GetIO().WantTextInput && ImGui::IsKeyPressed(ImGuiKey_Space))
+                toggle = true;
+            ImGui::SameLine();
+            ImGui::SetNextItemWidth(100);
+            int axis = static_cast<int>(animation.axis);
+            if (ImGui::Combo("##axis", &axis, "Steps\0Levels\0Members\0")) {
+                animation.axis = static_cast<AnimationAxis>(axis);
+                if (playing) {
+                    animation.stop();
+                    previousMessage = -1;
+                }
+            }
+            ImGui::SameLine();
+            ImGui::SetNextItemWidth(150);
+            ImGui::SliderFloat("fps", &animation.fps, 0.5f, 30.f, "%.1f");
+            ImGui::SameLine();
+            ImGui::Checkbox("Loop", &animation.loop);
+
+            if (playing && currentMessage != static_cast<int>(animation.shownGlobalIndex())) {
+                // the user moved to another message
+                animation.stop();
+            } else if (toggle && playing) {
+                animation.stop();
+                previousMessage = -1;
+            } else if (toggle) {
+                const auto& cur = collection.messageList[
+                    findSortedPos(collection.messageList, static_cast<size_t>(currentMessage))];
+                collection.seriesFor(cur, animation.axis, animationSeries);
+                renderer.progressiveRenderer.cancel();
+                animation.start(collection, animationSeries, static_cast<size_t>(currentMessage),
+                                settings);
+                if (!animation.active())
+                    ImGui::OpenPopup("Nothing to animate");
+            }
+            if (ImGui::BeginPopup("Nothing to animate")) {
+                ImGui::Text("This field has only one message along the selected axis.");
+                ImGui::EndPopup();
+            }
+
+            if (animation.active()) {
+                animation.update(renderer);
+                if (animation.active()) {
+                    currentMessage = static_cast<int>(animation.shownGlobalIndex());
+                    previousMessage = currentMessage;
+                    const AnimationStats& st = animation.stats();
+                    ImGui::Text("Frame %d / %d   %.1f fps (target %.1f)   dropped %d",
+                                animation.shownPosition() + 1, animation.length(), st.fps,
+                                animation.fps, st.dropped);
+                    ImGui::Text("Per frame: decode %.1f ms, colour %.1f ms, upload %.1f ms%s",
+                                st.decodeMs, st.renderMs, st.uploadMs,
+                                st.failed > 0 ? "   (some frames failed to decode)" : "");
+                } else {
+                    // reached the end without looping
+                    previousMessage = -1;
+                }
+            }
+        }
+
         if (currentMessage != previousMessage) {
             collection.readField(static_cast<size_t>(currentMessage), collection.currentField);
             previousMessage = currentMessage;
             updateImg = true;
+            lutFieldDirty = true;
         }
 
         ImGui::Separator();
 
         const auto& cur = collection.messageList[
             findSortedPos(collection.messageList, static_cast<size_t>(currentMessage))];
+        // during playback collection.currentField stays the message it started from
+        const GribField& shownField =
+            animation.hasFrame() ? animation.shownField() : collection.currentField;
 
         ImGui::Text("Field: %s (%s) (indicatorOfParameter: %ld) on typeOfLevel %s",
-                    collection.currentField.name.c_str(), collection.currentField.shortName.c_str(),
-                    collection.currentField.indicatorOfParameter,
-                    collection.currentField.indicatorOfTypeOfLevel.c_str());
+                    shownField.name.c_str(), shownField.shortName.c_str(),
+                    shownField.indicatorOfParameter,
+                    shownField.indicatorOfTypeOfLevel.c_str());
         ImGui::Text("    parameterNumber = %ld, category = %ld, discipline = %ld",
-                    collection.currentField.parameterNumber, collection.currentField.parameterCategory,
-                    collection.currentField.discipline);
-        ImGui::Text("Level: %ld", collection.currentField.level);
+                    shownField.parameterNumber, shownField.parameterCategory,
+                    shownField.discipline);
+        ImGui::Text("Level: %ld", shownField.level);
         ImGui::Text("    Type of level: %s (typeOfFirstFixedSurface: %s)",
-                    collection.currentField.typeOfLevel.c_str(),
-                    collection.currentField.typeOfFirstFixedSurface.c_str());
-        ImGui::Text("Units: %s", collection.currentField.units.c_str());
-        ImGui::Text("Dimensions: %ld x %ld", collection.currentField.width, collection.currentField.height);
-        ImGui::Text("Value range: %.6f to %.6f", collection.currentField.min_value,
-                    collection.currentField.max_value);
+                    shownField.typeOfLevel.c_str(),
+                    shownField.typeOfFirstFixedSurface.c_str());
+        ImGui::Text("Units: %s", shownField.units.c_str());
+        ImGui::Text("Dimensions: %ld x %ld", shownField.width, shownField.height);
+        ImGui::Text("Value range: %.6f to %.6f", shownField.min_value,
+                    shownField.max_value);
+        if (shownField.missingCount > 0) {
+            ImGui::SameLine();
+            ImGui::TextDisabled("(%zu missing)", shownField.missingCount);
+        }
         ImGui::Text("Plot value range: %.6f to %.6f", settings.minVal, settings.maxVal);
 
         if (cur.fileIdx < collection.filenames.size()) {
@@ -287,77 +554,168 @@ void showMainwindow(Renderer& renderer, char filename[512], GribCollection& coll
 
         ImGui::Separator();
 
-        visualizationSettingsWindow(settings, collection.currentField);
+        visualizationSettingsWindow(settings, shownField, animation.active());
         ImGui::End();
-        static size_t currentGradient = 0;
-        static size_t previousGradient = 0;
-        if (ImGui::BeginCombo("Gradient", mpl_gradient_names[currentGradient].c_str(), ImGuiComboFlags_HeightLarge)) {
-            for (size_t i = 0; i < mpl_gradient_names.size(); ++i) {
-                bool is_selected = (currentGradient == i);
-
-                if (ImGui::Selectable(mpl_gradient_names[i].c_str(), is_selected)) {
-                    currentGradient = i;
-                    settings.gradient = mpl_gradients[i];
+        const GradientRegistry& gradients = GradientRegistry::instance();
+        if (ImGui::BeginCombo("Gradient", gradients.name(settings.gradient), ImGuiComboFlags_HeightLarge)) {
+            // previews are only built for the rows the clipper shows
+            ImGuiListClipper clipper;
+            clipper.Begin(static_cast<int>(gradients.size()));
+            if (ImGui::IsWindowAppearing())
+                clipper.ForceDisplayRangeByIndices(static_cast<int>(settings.gradient),
+                                                   static_cast<int>(settings.gradient) + 1);
+            while (clipper.Step()) {
+                gradientAtlas.ensureRows(gradients, clipper.DisplayStart, clipper.DisplayEnd,
+                                         settings.brightness, settings.gamma,
+                                         settings.vibrancy, settings.hueShift);
+                for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+                    GradientHandle i = static_cast<GradientHandle>(row);
+                    bool is_selected = (settings.gradient == i);
+
+                    if (ImGui::Selectable(gradients.name(i), is_selected))
+                        settings.gradient = i;
+
+                    ImGui::SameLine(200);
+
+                    gradientAtlas.image(row, ImVec2(400, 18));
+
+                    if (is_selected) ImGui::SetItemDefaultFocus();
                 }
-
-                ImGui::SameLine(200);
-
-                ImGui::Image((ImTextureID)(intptr_t)mpl_gradients[i].previewTexture, ImVec2(400, 18));
-
-                if (is_selected) ImGui::SetItemDefaultFocus();
             }
 
             ImGui::EndCombo();
         }
         ImGui::SameLine();
         if (ImGui::Button("Reverse")) {
-            const std::string& name = mpl_gradient_names[currentGradient];
+            const std::string name = gradients.name(settings.gradient);
             std::string target = (name.size() >= 2 &&
                                   name.compare(name.size() - 2, 2, "_r") == 0)
                                  ? name.substr(0, name.size() - 2)
                                  : name + "_r";
-            for (size_t i = 0; i < mpl_gradient_names.size(); ++i) {
-                if (mpl_gradient_names[i] == target) {
-                    currentGradient = i;
-                    settings.gradient = mpl_gradients[i];
-                    break;
-                }
-            }
-        }
-        if (currentGradient != previousGradient) {
-            needNewTexture = true;
-            updateCbarTexture = true;
-            previousGradient = currentGradient;
+            GradientHandle reversed = gradients.find(target);
+            if (reversed != invalidGradient)
+                settings.gradient = reversed;
         }
 
         ImGui::BeginChild("Visualization", ImVec2(0, 0), true);
 
         if (settings != settings_old) {
-            needNewTexture = true;
+            // same size: recolour into the existing texture
+            updateImg = true;
             if (cmapUpgradeNeeded(settings_old, settings)) {
                 updateCbarTexture = true;
             }
+            if (settings.backend != settings_old.backend) {
+                lutFieldDirty = true;
+                lutGradientDirty = true;
+            }
+            if (settings.gradient != settings_old.gradient) lutGradientDirty = true;
             settings_old = settings;
+            animation.setSettings(settings);
         }
 
+        // zoomed out: show a pyramid level instead of the full-resolution field
+        const int zoomLevelIndex = std::min(settings.zoomOutLevel,
+                                            collection.currentField.pyramid.levelCount());
+        const PyramidLevel* zoomLevel = collection.currentField.pyramid.level(zoomLevelIndex);
+        const int wantWidth = zoomLevel ? zoomLevel->width : collection.currentField.width;
+        const int wantHeight = zoomLevel ? zoomLevel->height : collection.currentField.height;
+        if (wantWidth != displayWidth || wantHeight != displayHeight)
+            needNewTexture = true;
+
         if (needNewTexture) {
-            displayWidth = collection.currentField.width;
-            displayHeight = collection.currentField.height;
-            imgData.resize(displayHeight * displayWidth);
-            glDeleteTextures(1, &fieldTexture);
-            fieldTexture = 0;
-            fieldTexture = renderer.createTexture(displayWidth, displayHeight);
+            displayWidth = wantWidth;
+            displayHeight = wantHeight;
+            // created on first use: the tiled and LUT backends draw elsewhere
+            Renderer::deleteTexture(fieldTexture);
             needNewTexture = false;
             updateImg = true;
         }
 
-        if (updateImg) {
-            renderer.renderField(collection.currentField, displayWidth, displayHeight, settings,
-                                 imgData);
-            renderer.updateTexture(fieldTexture, displayWidth, displayHeight, imgData);
+        // during playback the field on screen comes from the animation
+        if (updateImg && !animation.active()) {
+            showingTiles = !zoomLevel && (settings.backend == RenderBackend::CpuTiled ||
+                                          TiledRenderer::needsTiling(collection.currentField));
+            showingLut = !zoomLevel && !showingTiles &&
+                         settings.backend == RenderBackend::LutShader && renderer.lutRenderer.init();
+            if (showingTiles) {
+                // the tiles hold what is visible; a full-size image would defeat them
+                std::vector<Color>().swap(imgData);
+            } else {
+                renderer.tiledRenderer.clear();
+                imgData.resize(static_cast<size_t>(displayWidth) * displayHeight);
+            }
+            imgDataMemory.set((imgData.capacity() + cbarData.capacity()) * sizeof(Color));
+            renderer.progressiveRenderer.cancel();
+            shownLevel = zoomLevel ? zoomLevelIndex : 0;
+            // whole-image cache entries use tileSize 0
+            TileCacheKey cacheKey{collection.currentGlobalIndex, renderSettingsHash(settings),
+                                  zoomLevelIndex, 0, 0, 0};
+            cachePending = false;
+            if (showingLut) {
+                if (lutFieldDirty) {
+                    renderer.lutRenderer.uploadField(collection.currentField);
+                    lutFieldDirty = false;
+                }
+                if (lutGradientDirty) {
+                    renderer.lutRenderer.uploadGradient(settings);
+                    lutGradientDirty = false;
+                }
+                // on failure (e.g. an empty custom range) the CPU path takes over and reports it
+                showingLut = renderer.lutRenderer.render(collection.currentField, settings);
+            }
+            if (showingLut)
+                Renderer::deleteTexture(fieldTexture);
+            else if (!showingTiles && !fieldTexture)
+                fieldTexture = renderer.createTexture(displayWidth, displayHeight);
+
+            if (zoomLevel) {
+                if (renderer.uploadFromCache(fieldTexture, cacheKey)) {
+                    imgDataStale = true;
+                } else {
+                    renderer.renderLevel(collection.currentField, zoomLevelIndex, settings, imgData);
+                    renderer.updateTexture(fieldTexture, displayWidth, displayHeight, imgData);
+                    pendingKey = cacheKey;
+                    cachePending = true;
+                    imgDataStale = false;
+                }
+            } else if (showingTiles) {
+                renderer.tiledRenderer.invalidate();
+                imgDataStale = true;
+            } else if (showingLut) {
+                imgDataStale = true;
+            } else if (renderer.uploadFromCache(fieldTexture, cacheKey)) {
+                imgDataStale = true;
+            } else if (settings.progressiveRendering &&
+                       ProgressiveRenderer::worthwhile(collection.currentField)) {
+                renderer.progressiveRenderer.start(renderer, collection.currentField, settings,
+                                                   fieldTexture, imgData);
+                progressiveKey = cacheKey;
+                imgDataStale = true;
+            } else {
+                renderer.renderField(collection.currentField, displayWidth, displayHeight, settings,
+                                     imgData);
+                renderer.updateTexture(fieldTexture, displayWidth, displayHeight, imgData);
+                pendingKey = cacheKey;
+                cachePending = true;
+                imgDataStale = false;
+            }
             updateImg = false;
         }
 
+        if (renderer.progressiveRenderer.running() &&
+            renderer.progressiveRenderer.step(renderer)) {
+            pendingKey = progressiveKey;
+            cachePending = true;
+            imgDataStale = false;
+        }
+        // every step of a slider drag has its own settings hash and would
+        // push useful entries out of the cache, so only settled images go in
+        if (cachePending && !imgDataStale && !ImGui::IsAnyItemActive()) {
+            renderer.tileCache.insert(pendingKey, displayWidth, displayHeight, imgData);
+            cachePending = false;
+        }
+
         if (updateCbarTexture) {
             renderer.updateCbar(cbarTexture, cbarWidth, cbarHeight, cbarData, settings);
             renderer.updateTexture(cbarTexture, cbarWidth, cbarHeight, cbarData);
@@ -365,10 +723,21 @@ void showMainwindow(Renderer& renderer, char filename[512], GribCollection& coll
         }
         ImGui::Image((ImTextureID)(intptr_t)cbarTexture, ImVec2(cbarWidth, cbarHeight));
         ImGui::Begin("Field Display", nullptr, ImGuiWindowFlags_AlwaysHorizontalScrollbar | ImGuiWindowFlags_AlwaysVerticalScrollbar);
-        ImGui::Image((ImTextureID)(intptr_t)fieldTexture,
-                     ImVec2(displayWidth * settings.displayZoomFactor,
-                            displayHeight * settings.displayZoomFactor),
-                     collection.currentField.uv1, collection.currentField.uv2);
+        if (animation.hasFrame()) {
+            animation.draw(static_cast<float>(settings.displayZoomFactor));
+        } else if (renderer.progressiveRenderer.running()) {
+            renderer.progressiveRenderer.draw(collection.currentField,
+                                              static_cast<float>(settings.displayZoomFactor));
+        } else if (showingTiles) {
+            renderer.tiledRenderer.draw(renderer, collection.currentField,
+                                        collection.currentGlobalIndex, settings);
+        } else {
+            GLuint shownTexture = showingLut ? renderer.lutRenderer.texture() : fieldTexture;
+            ImGui::Image((ImTextureID)(intptr_t)shownTexture,
+                         ImVec2(displayWidth * settings.displayZoomFactor,
+                                displayHeight * settings.displayZoomFactor),
+                         fieldUv1(collection.currentField), fieldUv2(collection.currentField));
+        }
         ImGui::End();
         ImGui::EndChild();
     } else {
@@ -402,7 +771,43 @@ void showMainwindow(Renderer& renderer, char filename[512], GribCollection& coll
         ImGui::EndPopup();
     }
 
+    if (exportPopupPending) {
+        ImGui::OpenPopup("Exporting animation");
+        exportPopupPending = false;
+    }
+    if (ImGui::BeginPopupModal("Exporting animation", nullptr,
+                               ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoMove)) {
+        const AnimationExportProgress& progress = animationExport.progress();
+        const int total = progress.total.load();
+        const int done = progress.done.load();
+        ImGui::TextUnformatted(animationExport.filename().c_str());
+        ImGui::Text("Frame %d of %d", done, total);
+        ImGui::ProgressBar(total > 0 ? static_cast<float>(done) / total : 0.f, ImVec2(400, 0));
+        if (ImGui::Button("Cancel")) animationExport.cancel();
+        if (!animationExport.running()) {
+            if (animationExport.succeeded())
+                std::cout << "Exported animation to " << animationExport.filename() << std::endl;
+            else
+                std::cerr << "Failed to export animation to " << animationExport.filename() << std::endl;
+            ImGui::CloseCurrentPopup();
+        } else {
+            frames.requestFrameIn(0.1);
+        }
+        ImGui::EndPopup();
+    }
+
+    if (showTraceOverlay)
+        traceOverlayWindow(&showTraceOverlay);
+    if (showMemoryWindow)
+        memoryWindow(&showMemoryWindow);
+
+    // work done a slice per frame keeps the loop awake until it finishes
+    if (renderer.progressiveRenderer.running())
+        frames.requestFrame();
+    frames.endFrame();
+
     // Rendering
+    TRACE_SCOPE("present", "ui");
     ImGui::Render();
     int display_w, display_h;
     glfwGetFramebufferSize(window, &display_w, &display_h);
@@ -420,5 +825,12 @@ void showMainwindow(Renderer& renderer, char filename[512], GribCollection& coll
 
     if (collection.loading) {
         collection.loadNext();
+        frames.requestFrame();
+    }
+
+    // background work holds on to the collection, which main() destroys after the loop
+    if (glfwWindowShouldClose(window)) {
+        animationExport.cancel();
+        animation.stop();
     }
 }
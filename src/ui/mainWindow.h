@@ -5,18 +5,27 @@
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 
+#include "animation_player.h"
 #include "grib_reader.h"
 #include "grib_collection.h"
 #include "mpl_gradients.h"
 #include "renderer.h"
 #include "settings.h"
 #include "color_adjust.h"
+#include "frame_scheduler.h"
+#include "trace.h"
 
 #include <tinyfiledialogs.h>
 
+#include "gradientAtlas.h"
+#include "memoryWindow.h"
 #include "messagesWindow.h"
+#include "traceOverlay.h"
 #include "visualizationSettingsWindow.h"
+#include "export_animation.h"
+#include "export_grib.h"
 #include "export_image.h"
+#include "export_values.h"
 
 void showMainwindow(Renderer& renderer, char filename[512], GribCollection& collection,
                     ImVec2& yScanDirectionA, ImVec2& yScanDirectionB, GLFWwindow* window,
@@ -0,0 +1,84 @@
+#include "memoryWindow.h"
+
+#include <cstdio>
+
+#include "../file_pool.h"
+#include "../memory_tracker.h"
+#include "../value_pool.h"
+
+static double toMiB(int64_t bytes) {
+    return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+void memoryWindow(bool* p_open) {
+    if (!ImGui::Begin("Memory", p_open)) {
+        ImGui::End();
+        return;
+    }
+
+    MemoryTracker& tracker = MemoryTracker::instance();
+    const int64_t total = tracker.total();
+    const size_t budget = tracker.budget();
+
+    char overlay[64];
+    snprintf(overlay, sizeof(overlay), "%.1f / %.0f MiB", toMiB(total), toMiB(budget));
+    float frac = budget > 0 ? static_cast<float>(total) / static_cast<float>(budget) : 0.0f;
+    if (frac > 1.0f)
+        ImGui::PushStyleColor(ImGuiCol_PlotHistogram, ImVec4(0.85f, 0.25f, 0.20f, 1.0f));
+    ImGui::ProgressBar(frac > 1.0f ? 1.0f : frac, ImVec2(-1, 0), overlay);
+    if (frac > 1.0f)
+        ImGui::PopStyleColor();
+
+    int budgetMiB = static_cast<int>(budget >> 20);
+    if (ImGui::InputInt("Budget (MiB)", &budgetMiB, 256, 1024) && budgetMiB > 0)
+        tracker.setBudget(static_cast<size_t>(budgetMiB) << 20);
+    ImGui::TextDisabled("Caches evict to stay within the budget");
+
+    if (ImGui::BeginTable("memory", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders)) {
+        ImGui::TableSetupColumn("Category");
+        ImGui::TableSetupColumn("Current (MiB)");
+        ImGui::TableSetupColumn("Peak (MiB)");
+        ImGui::TableHeadersRow();
+        for (int i = 0; i < MemoryTracker::categoryCount; ++i) {
+            const MemCategory c = static_cast<MemCategory>(i);
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(MemoryTracker::name(c));
+            ImGui::TableNextColumn();
+            ImGui::Text("%10.2f", toMiB(tracker.current(c)));
+            ImGui::TableNextColumn();
+            ImGui::Text("%10.2f", toMiB(tracker.peak(c)));
+        }
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted("Total");
+        ImGui::TableNextColumn();
+        ImGui::Text("%10.2f", toMiB(total));
+        ImGui::TableNextColumn();
+        ImGui::Text("%10.2f", toMiB(tracker.totalPeak()));
+        ImGui::EndTable();
+    }
+
+    if (ImGui::Button("Reset peaks"))
+        tracker.resetPeaks();
+
+    ValuePool& pool = ValuePool::instance();
+    const ValuePool::Stats values = pool.stats();
+    ImGui::Separator();
+    ImGui::Text("Value buffers: %zu allocated, %zu reused, %zu idle (%.1f MiB)", values.allocations,
+                values.reuses, values.idleBuffers, toMiB(static_cast<int64_t>(values.idleBytes)));
+    bool huge = pool.hugePages();
+    if (ImGui::Checkbox("Huge pages for large fields", &huge))
+        pool.setHugePages(huge);
+    ImGui::SameLine();
+    if (ImGui::Button("Free idle buffers"))
+        pool.trim();
+
+    const FilePool::Stats files = FilePool::instance().stats();
+    ImGui::Separator();
+    ImGui::Text("Open files: %zu / %zu (%zu registered)", files.open,
+                FilePool::instance().capacity(), files.files);
+    ImGui::Text("Opens: %zu, evictions: %zu, hits: %zu", files.opens, files.evictions, files.hits);
+
+    ImGui::End();
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <imgui.h>
+
+// Tracked memory by category with high-water marks, and the global budget.
+void memoryWindow(bool* p_open);
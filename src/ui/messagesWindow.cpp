@@ -1,5 +1,7 @@
 #include "messagesWindow.h" 
 
+#include "grib_collection.h"
+
 void gribMessageListWindow(
     bool* p_open,
     const std::vector<GribMessageInfo>& messageList,
@@ -74,63 +76,6 @@ void gribMessageListWindow(
     ImGui::End();
 }
 
-bool compareByKey(const GribMessageInfo& a,
-                  const GribMessageInfo& b,
-                  SortKey key)
-{
-    switch (key)
-    {
-        case SortKey::Name: return a.name < b.name;
-        case SortKey::ShortName: return a.shortName < b.shortName;
-        case SortKey::IndicatorOfParameter:
-            return a.indicatorOfParameter < b.indicatorOfParameter;
-        case SortKey::ParameterNumber:
-            return a.parameterNumber < b.parameterNumber;
-        case SortKey::Level:
-            return a.level < b.level;
-        case SortKey::PerturbationNumber:
-            return a.perturbationNumber < b.perturbationNumber;
-        case SortKey::IndicatorOfTypeOfLevel:
-            return a.indicatorOfParameter < b.indicatorOfParameter;
-        case SortKey::ParameterCategory:
-            return a.parameterCategory < b.parameterCategory;
-        case SortKey::Discipline:
-            return a.discipline < b.discipline;
-        case SortKey::TypeOfLevel:
-            return a.typeOfLevel < b.typeOfLevel;
-        case SortKey::typeOfFirstFixedSurface:
-            return a.typeOfFirstFixedSurface < b.typeOfFirstFixedSurface;
-        case SortKey::IndexInFile:
-            return a.indexInFile < b.indexInFile;
-        case SortKey::Step:
-            return a.step < b.step;
-        case SortKey::ValidityDateTime:
-            if (a.validityDate != b.validityDate) return a.validityDate < b.validityDate;
-            return a.validityTime < b.validityTime;
-        case SortKey::FileIdx:
-            return a.fileIdx < b.fileIdx;
-    }
-    return false;
-}
-
-void sortWithOrder(std::vector<GribMessageInfo>& list,
-                   const std::vector<SortColumn>& order)
-{
-    std::sort(list.begin(), list.end(),
-        [&](const auto& a, const auto& b)
-        {
-            for (const auto& col : order)
-            {
-                if (compareByKey(a, b, col.key))
-                    return col.ascending;
-
-                if (compareByKey(b, a, col.key))
-                    return !col.ascending;
-            }
-            return false;
-        });
-}
-
 void gribSortWindow(bool* p_open,
                     std::vector<GribMessageInfo>& messageList)
 {
@@ -0,0 +1,66 @@
+#include "traceOverlay.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "../eccodes_warmup.h"
+#include "../frame_scheduler.h"
+#include "../trace.h"
+
+void traceOverlayWindow(bool* p_open) {
+    static float frameTimes[240] = {};
+    static int frameOffset = 0;
+    static std::vector<TraceStage> stages;
+
+    Tracer& tracer = Tracer::instance();
+    frameTimes[frameOffset] = static_cast<float>(tracer.lastFrameMs());
+    frameOffset = (frameOffset + 1) % IM_ARRAYSIZE(frameTimes);
+
+    ImGui::SetNextWindowBgAlpha(0.85f);
+    if (!ImGui::Begin("Trace Overlay", p_open, ImGuiWindowFlags_AlwaysAutoResize)) {
+        ImGui::End();
+        return;
+    }
+
+    bool enabled = tracer.enabled();
+    if (ImGui::Checkbox("Tracing enabled", &enabled))
+        tracer.setEnabled(enabled);
+
+    ImGui::Text("Frame: %.2f ms", tracer.lastFrameMs());
+    const FrameScheduler& frames = FrameScheduler::instance();
+    ImGui::Text("Frames drawn: %lu, idle %.1f s", frames.framesDrawn(), frames.idleSeconds());
+    ImGui::PlotLines("##frametimes", frameTimes, IM_ARRAYSIZE(frameTimes), frameOffset,
+                     nullptr, 0.0f, 50.0f, ImVec2(300, 50));
+    const double firstFieldMs = tracer.timeToFirstFieldMs();
+    if (firstFieldMs >= 0.0)
+        ImGui::Text("First field after %.0f ms (ecCodes warm-up %.0f ms)", firstFieldMs,
+                    eccodesWarmupMs());
+
+    if (!enabled) {
+        ImGui::TextDisabled("Enable tracing to see stage timings");
+        ImGui::End();
+        return;
+    }
+
+    tracer.lastFrameStages(stages);
+    std::sort(stages.begin(), stages.end(),
+              [](const TraceStage& a, const TraceStage& b) { return a.ms > b.ms; });
+
+    if (ImGui::BeginTable("stages", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+        ImGui::TableSetupColumn("Stage");
+        ImGui::TableSetupColumn("ms");
+        ImGui::TableSetupColumn("calls");
+        ImGui::TableHeadersRow();
+        for (const TraceStage& s : stages) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(s.name);
+            ImGui::TableNextColumn();
+            ImGui::Text("%8.3f", s.ms);
+            ImGui::TableNextColumn();
+            ImGui::Text("%d", s.count);
+        }
+        ImGui::EndTable();
+    }
+    ImGui::End();
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <imgui.h>
+
+// Per-frame stage timings from the tracer, plus a frame time history.
+void traceOverlayWindow(bool* p_open);
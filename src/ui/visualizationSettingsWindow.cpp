@@ -1,27 +1,47 @@
 #include "visualizationSettingsWindow.h"
 
-void visualizationSettingsWindow(GribViewerSettings& settings, GribField& field) {
+void visualizationSettingsWindow(GribViewerSettings& settings, const GribField& field,
+                                 bool playing) {
     // Visualization
     ImGui::Begin("Visualization Settings");
     {
         ImGui::Text("Visualization:");
+        const char* backends[] = { "CPU (reference)", "GPU LUT shader", "CPU tiled (visible area only)" };
+        int backend = static_cast<int>(settings.backend);
+        if (ImGui::Combo("Renderer", &backend, backends, IM_ARRAYSIZE(backends)))
+            settings.backend = static_cast<RenderBackend>(backend);
+        ImGui::Checkbox("Progressive rendering (large grids)", &settings.progressiveRendering);
         ImGui::SliderInt("Display Zoom Factor", &settings.displayZoomFactor, 1, 10);
+        ImGui::SliderInt("Zoom out (pyramid level)", &settings.zoomOutLevel, 0,
+                         FieldPyramid::levelCountFor(field.width, field.height));
+        if (settings.zoomOutLevel > 0) {
+            const char* stats[] = { "Mean", "Min", "Max" };
+            int stat = static_cast<int>(settings.zoomOutStat);
+            if (ImGui::Combo("Zoom-out aggregation", &stat, stats, IM_ARRAYSIZE(stats)))
+                settings.zoomOutStat = static_cast<PyramidStat>(stat);
+        }
         ImGui::Checkbox("Use custom min and max", &settings.useCustomMinMax);
         if (settings.useCustomMinMax) {
             settings.symmetricAroundZero = false;
             ImGui::InputFloat("Minimum", &settings.minVal, 0.f, 0.f, "%.8f");
             ImGui::InputFloat("Maximum", &settings.maxVal, 0.f, 0.f, "%.8f");
         }
-        ImGui::Checkbox("Set symmetric around zero", &settings.symmetricAroundZero);
+        const bool symmetricChanged =
+            ImGui::Checkbox("Set symmetric around zero", &settings.symmetricAroundZero);
         ImGui::Checkbox("Use sqrt scaling", &settings.sqrtScale);
         ImGui::Checkbox("Use discrete colors", &settings.discreteColors);
         ImGui::InputInt("Color count (for discrete)", (int*)&settings.colorCount);
         ImGui::Checkbox("Old color bug (for aesthetics)", &settings.oldColorBug);
+        ImGui::ColorEdit3("Missing values", &settings.missingColor.r, ImGuiColorEditFlags_NoInputs);
+        if (field.missingCount > 0)
+            ImGui::TextDisabled("%zu of %zu points missing", field.missingCount, field.values.size());
         if (settings.symmetricAroundZero) {
             settings.useCustomMinMax = false;
-            float absMax = std::max(std::abs(field.min_value), std::abs(field.max_value));
-            settings.minVal = -absMax;
-            settings.maxVal = absMax;
+            if (!playing || symmetricChanged) {
+                float absMax = std::max(std::abs(field.min_value), std::abs(field.max_value));
+                settings.minVal = -absMax;
+                settings.maxVal = absMax;
+            }
         }
 
         ImGui::Separator();
@@ -4,5 +4,7 @@
 #include "../settings.h"
 #include "../grib_reader.h"
 
+// While `playing`, the symmetric range stays the one playback started with,
+// so every frame is coloured on the same scale.
 void visualizationSettingsWindow(GribViewerSettings& settings,
-    GribField& currentField);
+    const GribField& currentField, bool playing);
@@ -0,0 +1,125 @@
+#include "value_mask.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "task_scheduler.h"
+#include "trace.h"
+
+namespace {
+
+constexpr size_t wordsPerChunk = 1024;  // 64 Ki values
+
+// Min/max over eight lanes at a time in GCC/Clang vector types: GCC does
+// not vectorise a plain min/max reduction on doubles without -ffast-math.
+// NaN compares false, so it never replaces a bound, the same as vminpd.
+typedef double Lanes __attribute__((vector_size(64)));
+constexpr size_t laneCount = sizeof(Lanes) / sizeof(double);
+
+struct ChunkStats {
+    Lanes lo;
+    Lanes hi;
+    size_t missing = 0;
+
+    ChunkStats() {
+        for (size_t k = 0; k < laneCount; ++k) {
+            lo[k] = std::numeric_limits<double>::infinity();
+            hi[k] = -std::numeric_limits<double>::infinity();
+        }
+    }
+
+    void add(const double* v, size_t n) {
+        Lanes l = lo, h = hi;
+        size_t j = 0;
+        for (; j + laneCount <= n; j += laneCount) {
+            Lanes x;
+            std::memcpy(&x, v + j, sizeof(x));
+            l = x < l ? x : l;
+            h = x > h ? x : h;
+        }
+        for (; j < n; ++j) {
+            l[0] = v[j] < l[0] ? v[j] : l[0];
+            h[0] = v[j] > h[0] ? v[j] : h[0];
+        }
+        lo = l;
+        hi = h;
+    }
+};
+
+// Each word's mask comes from one compare per value; words with gaps get
+// their sentinels replaced by NaN, after which the same min/max loop skips
+// them without looking at bits.
+void scanWords(double* values, size_t count, double missing, uint64_t* mask,
+               size_t firstWord, size_t lastWord, ChunkStats& s) {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    for (size_t w = firstWord; w < lastWord; ++w) {
+        double* v = values + w * 64;
+        const size_t n = std::min<size_t>(64, count - w * 64);
+        uint64_t bits = 0;
+        for (size_t j = 0; j < n; ++j)
+            bits |= static_cast<uint64_t>(v[j] != missing) << j;
+        mask[w] = bits;
+        const size_t present = static_cast<size_t>(__builtin_popcountll(bits));
+        if (present != n) {
+            for (size_t j = 0; j < n; ++j) v[j] = v[j] != missing ? v[j] : nan;
+            s.missing += n - present;
+        }
+        s.add(v, n);
+    }
+}
+
+} // namespace
+
+size_t scanValues(double* values, size_t count, const double* missing,
+                  std::vector<uint64_t>& mask, double& minOut, double& maxOut) {
+    TRACE_SCOPE("scanValues", "decode");
+    const size_t words = maskWords(count);
+    const size_t chunks = (words + wordsPerChunk - 1) / wordsPerChunk;
+    std::vector<ChunkStats> stats(chunks);
+    if (missing) mask.resize(words);
+
+    parallelFor(0, static_cast<long>(chunks), [&](long c) {
+        const size_t firstWord = static_cast<size_t>(c) * wordsPerChunk;
+        const size_t lastWord = std::min(words, firstWord + wordsPerChunk);
+        if (missing)
+            scanWords(values, count, *missing, mask.data(), firstWord, lastWord, stats[c]);
+        else
+            stats[c].add(values + firstWord * 64, std::min(count, lastWord * 64) - firstWord * 64);
+    }, TaskScheduler::currentPriority(), 1);
+
+    double lo = std::numeric_limits<double>::infinity();
+    double hi = -std::numeric_limits<double>::infinity();
+    size_t missingCount = 0;
+    for (const ChunkStats& s : stats) {
+        for (size_t k = 0; k < laneCount; ++k) {
+            lo = std::min(lo, s.lo[k]);
+            hi = std::max(hi, s.hi[k]);
+        }
+        missingCount += s.missing;
+    }
+    if (missingCount == 0) mask.clear();
+    if (lo > hi) {
+        lo = 0.0;
+        hi = 0.0;
+    }
+    minOut = lo;
+    maxOut = hi;
+    return missingCount;
+}
+
+bool maskRangeFull(const uint64_t* mask, size_t begin, size_t count) {
+    if (count == 0) return true;
+    const size_t end = begin + count;
+    size_t w = begin >> 6;
+    const size_t lastWord = (end - 1) >> 6;
+    const uint64_t all = ~uint64_t(0);
+    const uint64_t head = all << (begin & 63);
+    const uint64_t tail = all >> (63 - ((end - 1) & 63));
+    if (w == lastWord) return (mask[w] & head & tail) == (head & tail);
+    if ((mask[w] & head) != head) return false;
+    for (++w; w < lastWord; ++w)
+        if (mask[w] != all) return false;
+    return (mask[lastWord] & tail) == tail;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Validity masks of decoded fields: bit i % 64 of word i / 64 is set when
+// value i is present. Fields without missing values have an empty mask, and
+// kernels take their unmasked path for them.
+
+inline bool maskBit(const uint64_t* mask, size_t i) {
+    return (mask[i >> 6] >> (i & 63)) & 1;
+}
+
+inline size_t maskWords(size_t count) {
+    return (count + 63) / 64;
+}
+
+// True when values [begin, begin + count) are all present, checked a word
+// at a time; kernels use it to take their unmasked loop for whole rows.
+bool maskRangeFull(const uint64_t* mask, size_t begin, size_t count);
+
+// One parallel pass over freshly decoded values: min and max of the present
+// values and, if `missing` is given, the mask. Values equal to *missing are
+// replaced by NaN so nothing downstream mistakes the sentinel for data.
+// Returns the number of missing values; the mask is emptied when there are
+// none. Min and max are 0 when no value is present.
+size_t scanValues(double* values, size_t count, const double* missing,
+                  std::vector<uint64_t>& mask, double& minOut, double& maxOut);
@@ -0,0 +1,203 @@
+#include "value_pool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+
+#include "memory_tracker.h"
+
+static constexpr size_t minClass = 512;  // doubles, 4 KiB
+
+// Idle buffers are charged here, so the dashboard sees them as decoded values.
+static MemoryCharge& idleCharge() {
+    static MemoryCharge* charge = new MemoryCharge(MemCategory::FieldValues);
+    return *charge;
+}
+
+ValuePool& ValuePool::instance() {
+    // never destroyed: fields held in other statics release into it on exit
+    static ValuePool* pool = new ValuePool();
+    return *pool;
+}
+
+ValuePool::ValuePool() {
+    const char* env = std::getenv("GRIBVIEWER_HUGE_PAGES");
+    huge = env && std::atoi(env) > 0;
+}
+
+size_t ValuePool::classSize(size_t count) {
+    if (count <= minClass) return minClass;
+    int bits = 0;
+    while ((count >> bits) > 1) ++bits;
+    const size_t step = size_t(1) << (bits - 2);
+    return (count + step - 1) / step * step;
+}
+
+double* ValuePool::allocate(size_t capacity, bool huge) {
+    const size_t bytes = capacity * sizeof(double);
+    if (bytes < hugePageBytes) {
+        void* p = nullptr;
+        if (posix_memalign(&p, alignment, bytes) != 0) return nullptr;
+        return static_cast<double*>(p);
+    }
+    // over-map by one huge page so the buffer can start on a 2 MiB boundary,
+    // then give back the ends; the kernel only backs aligned ranges with huge pages
+    const size_t mapped = bytes + hugePageBytes;
+    void* map = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) return nullptr;
+    const uintptr_t base = reinterpret_cast<uintptr_t>(map);
+    const uintptr_t start = (base + hugePageBytes - 1) & ~(uintptr_t(hugePageBytes) - 1);
+    // classes from 2 MiB up are multiples of 512 KiB, so both ends are page aligned
+    if (start > base) munmap(map, start - base);
+    if (base + mapped > start + bytes)
+        munmap(reinterpret_cast<void*>(start + bytes), base + mapped - (start + bytes));
+#ifdef MADV_HUGEPAGE
+    if (huge) madvise(reinterpret_cast<void*>(start), bytes, MADV_HUGEPAGE);
+#endif
+    return reinterpret_cast<double*>(start);
+}
+
+void ValuePool::deallocate(double* data, size_t capacity) {
+    const size_t bytes = capacity * sizeof(double);
+    if (bytes < hugePageBytes)
+        std::free(data);
+    else
+        munmap(data, bytes);
+}
+
+size_t ValuePool::idleLimit() const {
+    return MemoryTracker::instance().budget() / 8;
+}
+
+void ValuePool::chargeIdle() {
+    idleCharge().set(counters.idleBytes);
+}
+
+double* ValuePool::acquire(size_t count, size_t& capacity) {
+    capacity = classSize(count);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // the exact class, else the next one up
+        auto it = idle.lower_bound(capacity);
+        for (int tries = 0; tries < 2 && it != idle.end(); ++tries, ++it) {
+            if (it->second.empty() || it->first > classSize(capacity + 1)) continue;
+            double* data = it->second.back();
+            it->second.pop_back();
+            capacity = it->first;
+            ++counters.reuses;
+            --counters.idleBuffers;
+            counters.idleBytes -= capacity * sizeof(double);
+            chargeIdle();
+            return data;
+        }
+        ++counters.allocations;
+    }
+    return allocate(capacity, hugePages());
+}
+
+void ValuePool::release(double* data, size_t capacity) {
+    if (!data) return;
+    std::vector<std::pair<double*, size_t>> dropped;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle[capacity].push_back(data);
+        ++counters.idleBuffers;
+        counters.idleBytes += capacity * sizeof(double);
+        // largest first, until idle buffers fit their share of the budget
+        const MemoryTracker& tracker = MemoryTracker::instance();
+        for (auto it = idle.rbegin(); it != idle.rend() && counters.idleBytes > 0;) {
+            if (counters.idleBytes <= idleLimit() && !tracker.overBudget()) break;
+            if (it->second.empty()) {
+                ++it;
+                continue;
+            }
+            dropped.emplace_back(it->second.back(), it->first);
+            it->second.pop_back();
+            --counters.idleBuffers;
+            counters.idleBytes -= it->first * sizeof(double);
+            chargeIdle();  // overBudget() sees the new total
+        }
+        chargeIdle();
+    }
+    for (auto [buffer, size] : dropped) deallocate(buffer, size);
+}
+
+void ValuePool::trim() {
+    std::map<size_t, std::vector<double*>> dropped;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        dropped.swap(idle);
+        counters.idleBuffers = 0;
+        counters.idleBytes = 0;
+        chargeIdle();
+    }
+    for (auto& [capacity, buffers] : dropped)
+        for (double* data : buffers) deallocate(data, capacity);
+}
+
+void ValuePool::setHugePages(bool enable) {
+    std::lock_guard<std::mutex> lock(mutex);
+    huge = enable;
+}
+
+bool ValuePool::hugePages() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return huge;
+}
+
+ValuePool::Stats ValuePool::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+FieldValues::FieldValues(const FieldValues& o) {
+    *this = o;
+}
+
+FieldValues::FieldValues(FieldValues&& o) noexcept : ptr(o.ptr), count(o.count), cap(o.cap) {
+    o.ptr = nullptr;
+    o.count = 0;
+    o.cap = 0;
+}
+
+FieldValues& FieldValues::operator=(const FieldValues& o) {
+    if (this != &o && allocate(o.count) && count > 0)
+        std::memcpy(ptr, o.ptr, count * sizeof(double));
+    return *this;
+}
+
+FieldValues& FieldValues::operator=(FieldValues&& o) noexcept {
+    if (this != &o) {
+        clear();
+        std::swap(ptr, o.ptr);
+        std::swap(count, o.count);
+        std::swap(cap, o.cap);
+    }
+    return *this;
+}
+
+bool FieldValues::allocate(size_t n) {
+    // keep the buffer unless the new size would leave most of it unused
+    if (ptr && n <= cap && n >= cap / 2) {
+        count = n;
+        return true;
+    }
+    clear();
+    if (n == 0) return true;
+    ptr = ValuePool::instance().acquire(n, cap);
+    if (!ptr) {
+        cap = 0;
+        return false;
+    }
+    count = n;
+    return true;
+}
+
+void FieldValues::clear() {
+    ValuePool::instance().release(ptr, cap);
+    ptr = nullptr;
+    count = 0;
+    cap = 0;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <vector>
+
+// Recycles the buffers decoded fields keep their values in. Sizes are rounded
+// up to classes (four per power of two, so at most 25% slack) and released
+// buffers wait for the next field of a similar size, so browsing between
+// grids stops allocating and faulting in fresh pages. Buffers are 64-byte
+// aligned; from 2 MiB on they are mapped directly and can use transparent
+// huge pages. Idle buffers count as FieldValues memory and are freed rather
+// than kept when the memory budget is exceeded.
+class ValuePool {
+public:
+    static constexpr size_t alignment = 64;
+    static constexpr size_t hugePageBytes = size_t(2) << 20;
+
+    static ValuePool& instance();
+
+    ValuePool(const ValuePool&) = delete;
+    ValuePool& operator=(const ValuePool&) = delete;
+
+    // Room for at least `count` doubles, uninitialized; `capacity` receives
+    // the class size, which release() needs back. Null if out of memory.
+    double* acquire(size_t count, size_t& capacity);
+    void release(double* data, size_t capacity);
+    // Frees every idle buffer.
+    void trim();
+
+    // madvise(MADV_HUGEPAGE) on newly mapped buffers. Off by default;
+    // GRIBVIEWER_HUGE_PAGES=1 turns it on.
+    void setHugePages(bool enable);
+    bool hugePages() const;
+
+    struct Stats {
+        size_t allocations = 0;  // buffers taken from the system
+        size_t reuses = 0;       // acquires served by an idle buffer
+        size_t idleBuffers = 0;
+        size_t idleBytes = 0;
+    };
+    Stats stats() const;
+
+    static size_t classSize(size_t count);
+
+private:
+    ValuePool();
+
+    static double* allocate(size_t capacity, bool huge);
+    static void deallocate(double* data, size_t capacity);
+    size_t idleLimit() const;
+    void chargeIdle();
+
+    mutable std::mutex mutex;
+    std::map<size_t, std::vector<double*>> idle;  // by class size
+    bool huge = false;
+    Stats counters;
+};
+
+// A field's values: a contiguous array of doubles whose storage comes from
+// the ValuePool and goes back to it. Copying copies the values into a buffer
+// of the pool.
+class FieldValues {
+public:
+    FieldValues() = default;
+    FieldValues(const FieldValues& o);
+    FieldValues(FieldValues&& o) noexcept;
+    FieldValues& operator=(const FieldValues& o);
+    FieldValues& operator=(FieldValues&& o) noexcept;
+    ~FieldValues() { clear(); }
+
+    // Makes room for n values. The old values are not kept and the new ones
+    // are uninitialized; the buffer is reused when n fits it well enough.
+    bool allocate(size_t n);
+    void clear();
+
+    double* data() { return ptr; }
+    const double* data() const { return ptr; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    // Doubles allocated, for memory accounting.
+    size_t capacity() const { return cap; }
+
+    double& operator[](size_t i) { return ptr[i]; }
+    const double& operator[](size_t i) const { return ptr[i]; }
+    double* begin() { return ptr; }
+    double* end() { return ptr + count; }
+    const double* begin() const { return ptr; }
+    const double* end() const { return ptr + count; }
+
+private:
+    double* ptr = nullptr;
+    size_t count = 0;
+    size_t cap = 0;
+};
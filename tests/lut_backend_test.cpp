@@ -0,0 +1,176 @@
+// Renders synthetic fields with the CPU path (colorizeField) and the LUT
+// shader backend and compares the RGB8 results. Runs headless on an EGL
+// surfaceless context, i.e. Mesa's llvmpipe; exits with 77 (skipped) when
+// no GL 3.0 context can be created.
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "export_image.h"
+#include "field_render.h"
+#include "lut_renderer.h"
+
+namespace {
+
+constexpr int skipped = 77;
+
+bool createContext() {
+    auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+        eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    EGLDisplay display = EGL_NO_DISPLAY;
+    if (getPlatformDisplay)
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    EGLint major = 0, minor = 0;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) return false;
+    if (!eglBindAPI(EGL_OPENGL_API)) return false;
+    const EGLint attribs[] = {EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 0, EGL_NONE};
+    EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attribs);
+    if (context == EGL_NO_CONTEXT) return false;
+    return eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context);
+}
+
+// A smooth field with some noise, a band of missing values and values
+// outside the colour range on both ends.
+void makeField(GribField& field, int width, int height, bool withMissing) {
+    field.width = width;
+    field.height = height;
+    field.values.allocate(static_cast<size_t>(width) * height);
+    unsigned int seed = 12345;
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            seed = seed * 1664525u + 1013904223u;
+            const double noise = (seed >> 8) / double(1 << 24) - 0.5;
+            field.values[static_cast<size_t>(y) * width + x] =
+                280.0 + 25.0 * std::sin(x * 0.05) * std::cos(y * 0.07) + 3.0 * noise;
+        }
+    }
+    double missing = -9999.0;
+    if (withMissing) {
+        for (int y = height / 3; y < height / 2; ++y)
+            for (int x = width / 4; x < width / 2; ++x)
+                field.values[static_cast<size_t>(y) * width + x] = missing;
+    }
+    field.missingCount = scanValues(field.values.data(), field.values.size(),
+                                    withMissing ? &missing : nullptr, field.validMask,
+                                    field.min_value, field.max_value);
+}
+
+struct Case {
+    std::string name;
+    GribViewerSettings settings;
+};
+
+std::vector<Case> makeCases() {
+    const GradientRegistry& gradients = GradientRegistry::instance();
+    std::vector<Case> cases;
+    auto add = [&](const char* name, auto tweak) {
+        Case c{name, GribViewerSettings()};
+        tweak(c.settings);
+        cases.push_back(c);
+    };
+    add("default", [](GribViewerSettings&) {});
+    add("twilight", [&](GribViewerSettings& s) { s.gradient = gradients.find("twilight"); });
+    add("two-stop binary", [&](GribViewerSettings& s) { s.gradient = gradients.find("binary"); });
+    add("old colour bug", [](GribViewerSettings& s) { s.oldColorBug = true; });
+    add("sqrt scale", [](GribViewerSettings& s) { s.sqrtScale = true; });
+    add("discrete", [](GribViewerSettings& s) {
+        s.discreteColors = true;
+        s.colorCount = 12;
+    });
+    add("custom range", [](GribViewerSettings& s) {
+        s.useCustomMinMax = true;
+        s.minVal = 270.0f;
+        s.maxVal = 290.0f;
+    });
+    add("hcl adjustments", [](GribViewerSettings& s) {
+        s.brightness = 1.2f;
+        s.gamma = 0.8f;
+        s.vibrancy = 1.5f;
+        s.hueShift = 40.0f;
+    });
+    add("missing colour", [](GribViewerSettings& s) { s.missingColor = Color(1.0f, 0.0f, 1.0f); });
+    return cases;
+}
+
+}  // namespace
+
+int main() {
+    if (!createContext()) {
+        std::printf("no offscreen GL context, skipping\n");
+        return skipped;
+    }
+    std::printf("GL renderer: %s\n", reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+
+    LutRenderer lut;
+    if (!lut.init()) {
+        std::printf("LUT shader unavailable, skipping\n");
+        return skipped;
+    }
+
+    // LutRenderer's documented tolerance: one RGB8 step per channel, except
+    // for the rare value within float precision of a jump in the colour scale
+    constexpr int maxStep = 1;
+    constexpr double maxOffPixels = 1e-4;
+
+    const int width = 317;
+    const int height = 211;
+    int failures = 0;
+    for (bool withMissing : {false, true}) {
+        GribField field;
+        makeField(field, width, height, withMissing);
+        lut.uploadField(field);
+        for (const Case& c : makeCases()) {
+            std::vector<Color> colors(static_cast<size_t>(width) * height);
+            if (colorizeField(field, width, height, c.settings, colors) != ColorizeStatus::Ok) {
+                std::printf("FAIL %s: CPU path did not render\n", c.name.c_str());
+                ++failures;
+                continue;
+            }
+            std::vector<unsigned char> cpu, gpu;
+            colorsToRgb8(width, height, colors, false, cpu);
+
+            lut.uploadGradient(c.settings);
+            if (!lut.render(field, c.settings)) {
+                std::printf("FAIL %s: LUT backend did not render\n", c.name.c_str());
+                ++failures;
+                continue;
+            }
+            lut.readback(gpu);
+
+            int worst = 0;
+            size_t off = 0, exact = 0;
+            for (size_t i = 0; i < cpu.size(); i += 3) {
+                int d = 0;
+                for (int k = 0; k < 3; ++k) d = std::max(d, std::abs(cpu[i + k] - gpu[i + k]));
+                worst = std::max(worst, d);
+                if (d == 0) ++exact;
+                if (d > maxStep) ++off;
+            }
+            const size_t pixels = cpu.size() / 3;
+            const bool ok = off <= pixels * maxOffPixels;
+            std::printf("%s %s%s: %.3f%% exact, max difference %d, %zu beyond tolerance\n",
+                        ok ? "ok  " : "FAIL", c.name.c_str(), withMissing ? " (missing)" : "",
+                        100.0 * exact / pixels, worst, off);
+            if (!ok) ++failures;
+        }
+
+        // an empty custom range draws nothing, the same as the CPU path
+        GribViewerSettings empty;
+        empty.useCustomMinMax = true;
+        empty.minVal = empty.maxVal = 1.0f;
+        if (lut.render(field, empty)) {
+            std::printf("FAIL empty range rendered\n");
+            ++failures;
+        }
+    }
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}